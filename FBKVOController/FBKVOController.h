@@ -47,6 +47,479 @@ NS_ASSUME_NONNULL_BEGIN
  */
 typedef void (^FBKVONotificationBlock)(id _Nullable observer, id object, NSDictionary<NSString *, id> *change);
 
+/**
+ @abstract Function called on key-value change notification.
+ @param context The context of the observation.
+ @param object The object changed.
+ @param change The change dictionary.
+ */
+typedef void (*FBKVONotificationFunction)(void *_Nullable context, id object, NSDictionary<NSString *, id> *change);
+
+/**
+ @abstract Key of the change sequence number in stamped change dictionaries, an unsigned 64-bit NSNumber.
+ */
+FOUNDATION_EXPORT NSString *const FBKVONotificationSequenceKey;
+
+/**
+ @abstract Key of the change timestamp in stamped change dictionaries, an unsigned 64-bit NSNumber.
+ */
+FOUNDATION_EXPORT NSString *const FBKVONotificationTimestampKey;
+
+/**
+ @abstract Stamp of a key-value change, taken as the change is received.
+ */
+typedef struct {
+  /** Process-wide sequence number, increasing with every stamped change, across objects and key paths. */
+  uint64_t sequence;
+  /** Monotonic clock time of the change, in nanoseconds. */
+  uint64_t timestamp;
+} FBKVOChangeStamp;
+
+/**
+ @abstract The current monotonic clock time, in nanoseconds, comparable to change timestamps.
+ @discussion Use to measure delivery latency, subtracting the timestamp of the delivered change.
+ */
+FOUNDATION_EXPORT uint64_t FBKVOTimestampNow(void);
+
+/**
+ @abstract Block called on stamped key-value change notification.
+ @param observer The observer of the change.
+ @param object The object changed.
+ @param change The change dictionary, including the sequence and timestamp keys.
+ @param stamp The stamp of the change.
+ @discussion Stamps are taken on receipt of the change, before any queue hop, so a delivery whose sequence is lower than one already seen is outdated.
+ */
+typedef void (^FBKVOStampedNotificationBlock)(id _Nullable observer, id object, NSDictionary<NSString *, id> *change, FBKVOChangeStamp stamp);
+
+/**
+ @abstract Subscribers of an observable property, see FBKVO_OBSERVABLE_PROPERTY.
+ @discussion Storage only, accessed through the functions below.
+ */
+typedef struct {
+  /** An immutable snapshot of subscribers, or NULL if none. */
+  void *_Nullable _snapshot;
+} FBKVOObservableSubscribers;
+
+/**
+ @abstract Whether an observable property has subscribers.
+ @discussion A single relaxed load, using the compiler builtin so the header remains usable from C++.
+ */
+NS_INLINE BOOL FBKVOObservableHasSubscribers(FBKVOObservableSubscribers *subscribers)
+{
+  return NULL != __atomic_load_n(&subscribers->_snapshot, __ATOMIC_RELAXED);
+}
+
+/**
+ @abstract Notifies the subscribers of an observable property of a change.
+ @param subscribers The subscribers of the property.
+ @param object The object changed.
+ @param key The key of the property.
+ @param oldValue The boxed value before the change.
+ @param newValue The boxed value after the change.
+ */
+FOUNDATION_EXPORT void FBKVOObservableDidChange(FBKVOObservableSubscribers *subscribers, id object, NSString *key, id _Nullable oldValue, id _Nullable newValue);
+
+/**
+ This macro declares the subscriber storage of an observable property, within the instance variables of the implementation.
+
+ For example:
+
+ @implementation Circle {
+   FBKVO_OBSERVABLE_STORAGE(radius)
+ }
+ FBKVO_OBSERVABLE_PROPERTY(float, radius, Radius)
+ @end
+ */
+#define FBKVO_OBSERVABLE_STORAGE(NAME) FBKVOObservableSubscribers _##NAME##Subscribers;
+
+/**
+ This macro implements a nonatomic scalar property, declared with @property, whose changes are delivered to FBKVOController observers without Foundation KVO.
+ The capitalized name forms the setter, as the preprocessor cannot capitalize. Values are boxed with @(), and only when observed.
+ Setting without subscribers costs a single relaxed load. Foundation observers are still notified as usual, while FBKVOController observers of the key bypass Foundation entirely, and receive no prior notifications.
+ */
+#define FBKVO_OBSERVABLE_PROPERTY(TYPE, NAME, CAPITALIZED_NAME) \
+_FBKVO_OBSERVABLE_ACCESSORS(TYPE, NAME, CAPITALIZED_NAME, _FBKVO_OBSERVABLE_BOX_SCALAR)
+
+/**
+ This macro implements a nonatomic strong object property, as FBKVO_OBSERVABLE_PROPERTY.
+ */
+#define FBKVO_OBSERVABLE_OBJECT_PROPERTY(TYPE, NAME, CAPITALIZED_NAME) \
+_FBKVO_OBSERVABLE_ACCESSORS(TYPE, NAME, CAPITALIZED_NAME, _FBKVO_OBSERVABLE_BOX_OBJECT)
+
+#define _FBKVO_OBSERVABLE_BOX_SCALAR(VALUE) @(VALUE)
+#define _FBKVO_OBSERVABLE_BOX_OBJECT(VALUE) (VALUE)
+
+#define _FBKVO_OBSERVABLE_ACCESSORS(TYPE, NAME, CAPITALIZED_NAME, BOX) \
+@synthesize NAME = _##NAME; \
+- (FBKVOObservableSubscribers *)fbkvo_subscribers_##NAME \
+{ \
+  return &_##NAME##Subscribers; \
+} \
+- (TYPE)NAME \
+{ \
+  return _##NAME; \
+} \
+- (void)set##CAPITALIZED_NAME:(TYPE)value \
+{ \
+  if (!FBKVOObservableHasSubscribers(&_##NAME##Subscribers)) { \
+    _##NAME = value; \
+    return; \
+  } \
+  TYPE old = _##NAME; \
+  _##NAME = value; \
+  FBKVOObservableDidChange(&_##NAME##Subscribers, self, @#NAME, BOX(old), BOX(value)); \
+}
+
+/**
+ @abstract An immutable snapshot of aggregate values computed over a collection.
+ @discussion Values are derived from the numeric value of an element key path. Elements whose value is nil or not a number are counted, but otherwise ignored.
+ */
+@interface FBKVOAggregate : NSObject
+
+/** The number of elements in the collection, equivalent to @count. */
+@property (nonatomic, readonly) NSUInteger count;
+
+/** The sum of element values, equivalent to @sum. */
+@property (nonatomic, readonly) double sum;
+
+/** The average of element values, equivalent to @avg. Zero for an empty collection. */
+@property (nonatomic, readonly) double average;
+
+/** The smallest element value, equivalent to @min. Nil if no element has a numeric value. */
+@property (nullable, nonatomic, readonly) NSNumber *minimum;
+
+/** The largest element value, equivalent to @max. Nil if no element has a numeric value. */
+@property (nullable, nonatomic, readonly) NSNumber *maximum;
+
+@end
+
+/**
+ @abstract Block called on aggregate change.
+ @param observer The observer of the change.
+ @param object The object owning the observed collection.
+ @param aggregate The updated aggregate values.
+ */
+typedef void (^FBKVOAggregateBlock)(id _Nullable observer, id object, FBKVOAggregate *aggregate);
+
+/**
+ @abstract An immutable snapshot of the latest values of several observed object key paths.
+ */
+@interface FBKVOSnapshot : NSObject
+
+/** The number of object key paths in the snapshot. */
+@property (nonatomic, readonly) NSUInteger count;
+
+/**
+ @abstract Returns the latest value of the object key path at index.
+ @param index The index of the object key path, in the order specified on observation.
+ @return The latest value, or nil if the value is nil.
+ */
+- (nullable id)objectAtIndexedSubscript:(NSUInteger)index;
+
+/**
+ @abstract Returns the latest value of an object key path.
+ @param object The observed object.
+ @param keyPath The observed key path.
+ @return The latest value, or nil if the value is nil or the object key path is not part of the snapshot.
+ */
+- (nullable id)valueForObject:(id)object keyPath:(NSString *)keyPath;
+
+@end
+
+/**
+ @abstract Block called with the latest values of several observed object key paths.
+ @param observer The observer of the change.
+ @param snapshot The latest values.
+ */
+typedef void (^FBKVOCombineLatestBlock)(id _Nullable observer, FBKVOSnapshot *snapshot);
+
+/**
+ @abstract Block transforming a bound value.
+ @param value The source value.
+ @return The value to set on the target.
+ */
+typedef id _Nullable (^FBKVOBindingTransform)(id _Nullable value);
+
+/**
+ @abstract Priority of asynchronous delivery.
+ */
+typedef NS_ENUM(NSInteger, FBKVODeliveryPriority) {
+  /** Delivered on the specified queue directly. */
+  FBKVODeliveryPriorityDefault = 0,
+
+  /** Delivered through a user-interactive lane, overtaking lower priority backlogs. */
+  FBKVODeliveryPriorityHigh,
+
+  /** Delivered through a utility lane. */
+  FBKVODeliveryPriorityLow,
+
+  /** Delivered through a background lane, for work such as analytics or caching. */
+  FBKVODeliveryPriorityBackground,
+};
+
+/**
+ @abstract A source of frame ticks, driving frame-aligned delivery.
+ @discussion Implement this protocol to align delivery with a display link, or to tick frames deterministically in tests.
+ */
+@protocol FBKVOFrameClock <NSObject>
+
+/**
+ @abstract Schedules a block to run once, on the next frame tick.
+ @param block The block to run.
+ */
+- (void)performOnNextFrame:(dispatch_block_t)block;
+
+@end
+
+/**
+ @abstract A frame clock ticking on a dispatch timer.
+ @discussion The timer only runs while blocks are scheduled, so an idle clock causes no wakeups.
+ */
+@interface FBKVODispatchFrameClock : NSObject <FBKVOFrameClock>
+
+/**
+ @abstract A shared clock ticking on the main queue at 60 frames per second.
+ */
++ (instancetype)sharedClock;
+
+/**
+ @abstract The designated initializer.
+ @param queue The queue on which to run scheduled blocks.
+ @param framesPerSecond The tick rate.
+ @return The initialized frame clock.
+ */
+- (instancetype)initWithQueue:(dispatch_queue_t)queue framesPerSecond:(NSUInteger)framesPerSecond NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+/**
+ @abstract An executor running notification deliveries.
+ @discussion Implement this protocol to deliver notifications on custom thread pools or run loops, without a hop through a dispatch queue.
+ */
+@protocol FBKVOExecutor <NSObject>
+
+/**
+ @abstract Enqueues a batch of deliveries of one observation.
+ @param blocks The deliveries to run, in order.
+ @param count The number of deliveries.
+ @param observation An opaque token identifying the observation.
+ @discussion Called from the thread of the change. Deliveries of the same observation must run in order and must not overlap. Buffered notifications, such as on transaction commit or resume, are enqueued in batches.
+ */
+- (void)enqueueBlocks:(const dispatch_block_t _Nonnull [_Nonnull])blocks count:(NSUInteger)count observation:(id)observation;
+
+@end
+
+/**
+ @abstract An executor running deliveries on a dispatch queue.
+ @discussion Deliveries are queued in a mailbox per queue, and a burst of deliveries is run by a single drain on the queue.
+ */
+@interface FBKVODispatchExecutor : NSObject <FBKVOExecutor>
+
+/**
+ @abstract A shared executor running deliveries on the main queue.
+ */
++ (instancetype)mainQueueExecutor;
+
+/**
+ @abstract The designated initializer.
+ @param queue The queue on which to run deliveries. A concurrent queue does not preserve order.
+ @return The initialized executor.
+ */
+- (instancetype)initWithQueue:(dispatch_queue_t)queue NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+/**
+ @abstract An executor running deliveries immediately, on the thread of the change.
+ @discussion Useful for run loop based threads, and for observations only occasionally delivered through a batch.
+ */
+@interface FBKVOCurrentThreadExecutor : NSObject <FBKVOExecutor>
+
+/**
+ @abstract The shared executor.
+ */
++ (instancetype)sharedExecutor;
+
+@end
+
+/**
+ @abstract An executor running deliveries on a pool of worker threads.
+ @discussion Deliveries of different observations run in parallel, while deliveries of each observation run in order and never overlap. Each observation is drained by one worker at a time. Idle workers steal pending observations from busy ones, balancing CPU-heavy observers across cores. Use for observers that are thread-safe with respect to each other.
+ */
+@interface FBKVOWorkStealingExecutor : NSObject <FBKVOExecutor>
+
+/**
+ @abstract A shared executor with a worker per active processor.
+ */
++ (instancetype)sharedExecutor;
+
+/**
+ @abstract The designated initializer.
+ @param threadCount The number of worker threads. Workers exit once the executor is deallocated.
+ @return The initialized executor.
+ */
+- (instancetype)initWithThreadCount:(NSUInteger)threadCount NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+/**
+ @abstract A key-value change record, unpacked from a change dictionary.
+ */
+@interface FBKVOChange : NSObject
+
+/**
+ @abstract The object changed.
+ */
+@property (nonatomic, strong, readonly) id object;
+
+/**
+ @abstract The kind of change.
+ */
+@property (nonatomic, assign, readonly) NSKeyValueChange kind;
+
+/**
+ @abstract The old value, nil if none or NSNull.
+ */
+@property (nullable, nonatomic, strong, readonly) id oldValue;
+
+/**
+ @abstract The new value, nil if none or NSNull.
+ */
+@property (nullable, nonatomic, strong, readonly) id newValue;
+
+/**
+ @abstract The indexes of an ordered to-many change, nil otherwise.
+ */
+@property (nullable, nonatomic, strong, readonly) NSIndexSet *indexes;
+
+/**
+ @abstract Monotonic clock time the change was received, comparable to FBKVOTimestampNow().
+ */
+@property (nonatomic, assign, readonly) uint64_t timestamp;
+
+/**
+ @abstract Initializes a change from a key-value change dictionary, timestamped now.
+ @param object The object changed.
+ @param change The change dictionary.
+ */
+- (instancetype)initWithObject:(id)object change:(nullable NSDictionary<NSString *, id> *)change;
+
+@end
+
+/**
+ @abstract Behavior of a full stream on change.
+ */
+typedef NS_ENUM(NSInteger, FBKVOStreamOverflowPolicy) {
+  /** The change is dropped and counted, the changing thread never waits. */
+  FBKVOStreamOverflowPolicyDropNewest = 0,
+
+  /** The changing thread waits for the consumer to make room. */
+  FBKVOStreamOverflowPolicyBlock,
+};
+
+/**
+ @abstract A pull-based stream of changes to an observed key path.
+ @discussion Backed by a fixed-capacity ring buffer with a single consumer. Changes are pushed synchronously on the changing thread, independent of observer, queue and executor. Changing threads are serialized among themselves, while the consumer takes changes without locking. Consume from one thread at a time.
+ */
+@interface FBKVOStream : NSObject
+
+/**
+ @abstract The number of changes the stream buffers, a power of two.
+ */
+@property (nonatomic, assign, readonly) NSUInteger capacity;
+
+/**
+ @abstract Behavior on change while the stream is full. Default is FBKVOStreamOverflowPolicyDropNewest.
+ */
+@property (atomic, assign) FBKVOStreamOverflowPolicy overflowPolicy;
+
+/**
+ @abstract The number of changes buffered since creation.
+ */
+@property (nonatomic, assign, readonly) uint64_t enqueuedCount;
+
+/**
+ @abstract The number of changes dropped since creation, as the stream was full.
+ */
+@property (nonatomic, assign, readonly) uint64_t droppedCount;
+
+/**
+ @abstract Whether the stream was cancelled.
+ */
+@property (nonatomic, assign, readonly, getter=isCancelled) BOOL cancelled;
+
+/**
+ @abstract Takes the oldest buffered change without waiting.
+ @return The change, or nil if none is buffered.
+ */
+- (nullable FBKVOChange *)tryNext;
+
+/**
+ @abstract Takes the oldest buffered change, waiting for one if needed.
+ @return The change, or nil once the stream is cancelled and drained.
+ */
+- (nullable FBKVOChange *)next;
+
+/**
+ @abstract Takes all buffered changes without waiting.
+ @param changes The array to append changes to, oldest first.
+ @return The number of changes taken.
+ */
+- (NSUInteger)drainInto:(NSMutableArray<FBKVOChange *> *)changes;
+
+/**
+ @abstract Stops observing, waking a consumer waiting in -next. Buffered changes can still be taken.
+ */
+- (void)cancel;
+
+@end
+
+@class FBKVOComputed;
+
+/**
+ @abstract Block evaluating a computed value.
+ @param computed The computed object being evaluated. Read observed values through -valueForObject:keyPath: to track them as dependencies.
+ @return The computed value.
+ */
+typedef id _Nullable (^FBKVOComputedBlock)(FBKVOComputed *computed);
+
+/**
+ @abstract A memoized value derived from observed key paths.
+ @discussion The computed block reads its inputs through -valueForObject:keyPath:, which records each object key path read as a dependency and observes it through an FBKVOController owned by the computed. Dependencies are re-collected on every evaluation, so conditional reads are tracked correctly.
+ The result is cached. A dependency change only marks the computed, and any computed depending on it, as stale. Re-evaluation happens lazily on the next read of value, or eagerly once the change completes if value is observed. Since every stale computed is marked before any is re-evaluated, a computed never observes a mix of old and new inputs.
+ The value property is key-value observable, and notifies observers only when the result actually changes, as determined by -isEqual:. Observed dependencies are retained.
+ */
+@interface FBKVOComputed : NSObject
+
+/**
+ @abstract Creates and returns a computed value.
+ @param block The block evaluating the value. The block is evaluated once on creation, to collect initial dependencies. In order to avoid retain loops, the block must avoid referencing the computed.
+ @return The computed value.
+ */
++ (instancetype)computedWithBlock:(FBKVOComputedBlock)block;
+
+/**
+ @abstract The computed value, re-evaluated if a dependency changed since the last evaluation.
+ */
+@property (nullable, atomic, readonly) id value;
+
+/**
+ @abstract Reads an object key path, tracking it as a dependency.
+ @param object The object to read.
+ @param keyPath The key path to read.
+ @return The value of the key path.
+ @discussion Must only be called from within the computed block. Reading the value of another FBKVOComputed creates a direct dependency on it, without going through Foundation KVO.
+ */
+- (nullable id)valueForObject:(id)object keyPath:(NSString *)keyPath;
+
+@end
+
 /**
  @abstract FBKVOController makes Key-Value Observing simpler and safer.
  @discussion FBKVOController adds support for handling key-value changes with blocks and custom actions, as well as the NSKeyValueObserving callback. Notification will never message a deallocated observer. Observer removal never throws exceptions, and observers are removed implicitly on controller deallocation. FBKVOController is also thread safe. When used in a concurrent environment, it protects observers from possible resurrection and avoids ensuing crash. By default, the controller maintains a strong reference to objects observed.
@@ -85,7 +558,7 @@ typedef void (^FBKVONotificationBlock)(id _Nullable observer, id object, NSDicti
 /**
  @abstract Set or disable global main-thread safety.
  @param observeOnMainQueueByDefault If YES, observers will be created as if the queue parameter were set to the main queue. Default is NO.
- @discussion If set to YES, observers will only be called synchronously for changes that occur on the main queue. Changes that occur outside the main queue will call their observers asynchronously, so the observed values may be out of date.
+ @discussion Applies to subsequent observations of controllers whose defaultQueue was not assigned. If set to YES, observers will only be called synchronously for changes that occur on the main queue. Changes that occur outside the main queue will call their observers asynchronously, so the observed values may be out of date. Asynchronous notifications are queued in order in a mailbox per queue, and a burst of changes is delivered by a single drain on the queue.
  */
 + (void)setObserveOnMainQueueByDefault:(BOOL)observeOnMainQueueByDefault;
 
@@ -95,8 +568,120 @@ typedef void (^FBKVONotificationBlock)(id _Nullable observer, id object, NSDicti
 + (BOOL)observeOnMainQueueByDefault;
 
 
+/**
+ @abstract Limits the nesting depth of synchronous notifications.
+ @param maximumNotificationDepth The maximum number of notifications nested on a thread, as when observers change observed values. Default is NSUIntegerMax, meaning unlimited.
+ @discussion Rather than recursing, notifications past the maximum depth are deferred, and delivered on the same thread once the outermost notification returns.
+ */
++ (void)setMaximumNotificationDepth:(NSUInteger)maximumNotificationDepth;
+
+/**
+ @abstract The maximum nesting depth of synchronous notifications.
+ */
++ (NSUInteger)maximumNotificationDepth;
+
+/**
+ @abstract Sets the handler of notification cycles.
+ @param handler The block called with the key paths forming a cycle, outermost first, or nil to not report cycles.
+ @discussion A cycle is reported when a notification past the maximum notification depth is deferred while a notification for the same observation is already being delivered on the thread. A single re-entry within the maximum depth, as when an observer clamps the value it observes, is not reported. A cycle is reported once per outermost notification.
+ */
++ (void)setNotificationCycleHandler:(nullable void (^)(NSArray<NSString *> *keyPaths))handler;
+
+/**
+ @abstract Begins a notification transaction on the current thread.
+ @discussion Until the matching +commit, notifications to any KVO controller caused by changes on the current thread are buffered rather than delivered. Repeated value changes of an observed object key path are coalesced into a single notification, carrying the first old value and the last new value. Transactions may be nested; notifications are delivered when the outermost transaction commits. Transactions are scoped to the thread, not the queue: begin and commit within a single block, as changes made by later blocks of the same serial queue may run on other threads and are not covered.
+ */
++ (void)beginTransaction;
+
+/**
+ @abstract Commits the current thread's notification transaction.
+ @discussion On commit of the outermost transaction, buffered notifications are delivered once each, in observation registration order. Notifications for observations removed during the transaction are dropped. Notifications caused by observers during delivery are delivered immediately.
+ */
++ (void)commit;
+
+/**
+ @abstract Blocks the calling thread until an observed value satisfies a predicate.
+ @param object The object to observe.
+ @param keyPath The key path to observe.
+ @param predicate The predicate evaluated on the current value, then on the new value after each change.
+ @param timeout The maximum time to wait, in seconds.
+ @return YES once the predicate is satisfied, NO on timeout.
+ @discussion Rather than polling, the thread sleeps on a condition variable signaled by change notifications, waking only when the value may have changed. The predicate runs on the calling thread. Changes must occur on other threads.
+ */
++ (BOOL)waitForObject:(id)object keyPath:(NSString *)keyPath predicate:(BOOL (^)(id _Nullable value))predicate timeout:(NSTimeInterval)timeout;
+
+/**
+ @abstract The queue on which notifications of observations without an explicit queue are delivered.
+ @discussion Until assigned, follows the global default set by +setObserveOnMainQueueByDefault:. NULL delivers notifications on the thread of the change (standard KVO behavior). Changing the queue affects subsequent observations only.
+ */
+@property (atomic, nullable, strong) dispatch_queue_t defaultQueue;
+
+/**
+ @abstract If YES, observations of the receiver will be created as if the queue parameter were set to the main queue.
+ @discussion Equivalent to setting defaultQueue to the main queue, or to NULL.
+ */
 @property (nonatomic) BOOL observeOnMainQueueByDefault;
 
+/**
+ @abstract If YES, callbacks of the receiver are serialized, whatever the notifying threads.
+ @discussion Callbacks never overlap, so observer code needs no locks of its own. A callback runs on the notifying thread if no other callback of the receiver is running, without allocating. Otherwise, it is queued and run in order on a thread borrowed from a shared worker pool. Applies to observations delivered on the notifying thread only; observations with a queue or executor, including the default queue, are still delivered there, and are not serialized with other callbacks. No dispatch queue is created per controller. Default is NO.
+ */
+@property (nonatomic, getter=isSerial) BOOL serial;
+
+/**
+ @abstract Waits until no asynchronous delivery of the receiver is in flight.
+ @param timeout The maximum time to wait, in seconds.
+ @return YES if all deliveries have run, NO on timeout.
+ @discussion Covers deliveries enqueued on queues, executors and the serial actor, changes awaiting a frame, and combined and aggregate notifications. Deliveries enqueued while waiting are waited for too. Blocks the calling thread, so must not be called from a queue or thread the pending deliveries need.
+ */
+- (BOOL)flushWithTimeout:(NSTimeInterval)timeout;
+
+/**
+ @abstract Calls a block once no asynchronous delivery of the receiver is in flight.
+ @param completion The block to call, immediately if nothing is in flight, otherwise on the thread running the last delivery.
+ */
+- (void)flushWithCompletion:(dispatch_block_t)completion;
+
+/**
+ @abstract Whether notification of all observations is paused.
+ */
+@property (nonatomic, readonly, getter=isPaused) BOOL paused;
+
+/**
+ @abstract Pauses notification of all observations, dropping notifications until resumed.
+ @discussion Observations stay registered in Foundation, so pausing and resuming is considerably cheaper than unobserving and observing again.
+ */
+- (void)pause;
+
+/**
+ @abstract Pauses notification of all observations.
+ @param retainLatest If YES, notifications are coalesced per observation and retained, to be delivered on resume. Past 64 retained changes that do not coalesce, such as collection mutations, they collapse into a single setting change of the value current on resume. If NO, notifications are dropped, along with those retained by an earlier retaining pause.
+ */
+- (void)pauseRetainingLatest:(BOOL)retainLatest;
+
+/**
+ @abstract Resumes notification of all observations.
+ @discussion Retained notifications are delivered once per changed observation, carrying the first old value and the latest new value, except for observations paused individually.
+ */
+- (void)resume;
+
+/**
+ @abstract Pauses notification of an object key path observation.
+ @param object The observed object.
+ @param keyPath The observed key path.
+ @param retainLatest If YES, notifications are coalesced and retained, to be delivered on resume. If NO, notifications are dropped.
+ @discussion If not observing object key path, this method results in no operation.
+ */
+- (void)pause:(nullable id)object keyPath:(NSString *)keyPath retainingLatest:(BOOL)retainLatest;
+
+/**
+ @abstract Resumes notification of an object key path observation.
+ @param object The observed object.
+ @param keyPath The observed key path.
+ @discussion Retained notifications are delivered, unless the controller is paused. If not observing object key path, this method results in no operation.
+ */
+- (void)resume:(nullable id)object keyPath:(NSString *)keyPath;
+
 /**
  @abstract Registers observer for key-value change notification.
  @param object The object to observe.
@@ -107,6 +692,81 @@ typedef void (^FBKVONotificationBlock)(id _Nullable observer, id object, NSDicti
  */
 - (void)observe:(nullable id)object keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options block:(FBKVONotificationBlock)block;
 
+/**
+ @abstract Registers observer for stamped key-value change notification.
+ @param object The object to observe.
+ @param keyPath The key path to observe.
+ @param options The NSKeyValueObservingOptions to use for observation.
+ @param block The block to execute on notification, with the stamp of the change.
+ @discussion Delivered like -observe:keyPath:options:block:. Only stamped observations pay for sequence numbers and timestamps. Coalesced changes carry the stamp of the latest change. Observing an already observed object key path or nil results in no operation.
+ */
+- (void)observe:(nullable id)object keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options stampedBlock:(FBKVOStampedNotificationBlock)block;
+
+/**
+ @abstract Creates a stream of changes to an object key path.
+ @param object The object to observe.
+ @param keyPath The key path to observe.
+ @param capacity The number of changes buffered, rounded up to a power of two.
+ @return The stream, or nil if the object key path is already observed or object is nil.
+ @discussion Old and new values are recorded. Changes are buffered until taken. Unobserving the object key path or cancelling the stream stops buffering.
+ */
+- (nullable FBKVOStream *)streamForObject:(nullable id)object keyPath:(NSString *)keyPath capacity:(NSUInteger)capacity;
+
+/**
+ @abstract Registers observer for a single key-value change notification.
+ @param object The object to observe.
+ @param keyPath The key path to observe.
+ @param options The NSKeyValueObservingOptions to use for observation.
+ @param block The block to execute on notification.
+ @discussion Equivalent to -observe:keyPath:options:count:block: with a count of 1.
+ */
+- (void)observeOnce:(nullable id)object keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options block:(FBKVONotificationBlock)block;
+
+/**
+ @abstract Registers observer for a limited number of key-value change notifications.
+ @param object The object to observe.
+ @param keyPath The key path to observe.
+ @param options The NSKeyValueObservingOptions to use for observation.
+ @param count The number of notifications to deliver, counting the initial notification but not prior notifications.
+ @param block The block to execute on notification.
+ @discussion The observation removes itself when the last notification is claimed, before it is delivered, so the block may observe the key path again. Notifications racing on other threads are claimed atomically, and never delivered past count. Observing an already observed object key path or nil results in no operation.
+ */
+- (void)observe:(nullable id)object keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options count:(NSUInteger)count block:(FBKVONotificationBlock)block;
+
+/**
+ @abstract Registers observer for key-value change notification, delivered asynchronously at a priority.
+ @param object The object to observe.
+ @param keyPath The key path to observe.
+ @param options The NSKeyValueObservingOptions to use for observation.
+ @param queue The queue on which to invoke the block. If the change occurs on the specified queue, the block is called synchronously, otherwise it is dispatched asynchronously.
+ @param priority The delivery priority.
+ @param block The block to execute on notification.
+ @discussion Other than the default priority, notifications are dispatched through a serial lane targeting the queue, with a quality of service matching the priority where available. Lanes are shared per queue and priority, and preserve order within a priority, while allowing higher priority changes to overtake lower priority backlogs. A lane retains its queue only while observations use it. Observing an already observed object key path or nil results in no operation.
+ */
+- (void)observe:(nullable id)object keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options queue:(dispatch_queue_t)queue priority:(FBKVODeliveryPriority)priority block:(FBKVONotificationBlock)block;
+
+/**
+ @abstract Registers observer for key-value change notification delivered by an executor.
+ @param object The object to observe.
+ @param keyPath The key path to observe.
+ @param options The NSKeyValueObservingOptions to use for observation.
+ @param executor The executor running deliveries.
+ @param block The block to execute on notification, as run by the executor.
+ @discussion Observing an already observed object key path or nil results in no operation.
+ */
+- (void)observe:(nullable id)object keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options executor:(id<FBKVOExecutor>)executor block:(FBKVONotificationBlock)block;
+
+/**
+ @abstract Registers observer for frame-aligned key-value change notification.
+ @param object The object to observe.
+ @param keyPath The key path to observe.
+ @param options The NSKeyValueObservingOptions to use for observation.
+ @param frameClock The frame clock sampling changes, or nil to use the shared dispatch frame clock.
+ @param block The block to execute on notification, on the frame clock's queue.
+ @discussion Rather than on every change, the block is called at most once per frame tick, with the latest change since the previous tick. Consecutive value changes are coalesced, carrying the first old value and the last new value. Use for values driving rendering. Observing an already observed object key path or nil results in no operation.
+ */
+- (void)observe:(nullable id)object keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options frameClock:(nullable id<FBKVOFrameClock>)frameClock block:(FBKVONotificationBlock)block;
+
 /**
  @abstract Registers observer for key-value change notification.
  @param object The object to observe.
@@ -123,7 +783,7 @@ typedef void (^FBKVONotificationBlock)(id _Nullable observer, id object, NSDicti
  @param keyPath The key path to observe.
  @param options The NSKeyValueObservingOptions to use for observation.
  @param action The observer selector called on key-value change.
- @param queue The queue on which to invoke the action, or nil to use the current queue when the change occurs (standard KVO behavior). If the main queue is specified and the change occurs on the main queue, the action be called synchronously, otherwise it will be dispatched asynchronously.
+ @param queue The queue on which to invoke the action, or nil to use the current queue when the change occurs (standard KVO behavior). If the change occurs on the specified queue, the action will be called synchronously, otherwise it will be dispatched asynchronously.
  @discussion On key-value change, the observer's action selector is called. The selector provided should take the form of -propertyDidChange, -propertyDidChange: or -propertyDidChange:object:, where optional parameters delivered will be KVO change dictionary and object observed. Observing nil or observing an already observed object's key path results in no operation.
  */
 - (void)observe:(nullable id)object keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options action:(SEL)action queue:(nullable dispatch_queue_t)queue;
@@ -165,7 +825,7 @@ typedef void (^FBKVONotificationBlock)(id _Nullable observer, id object, NSDicti
  @param keyPaths The key paths to observe.
  @param options The NSKeyValueObservingOptions to use for observation.
  @param action The observer selector called on key-value change.
- @param queue The queue on which to invoke the action, or nil to use the current queue when the change occurs (standard KVO behavior). If the main queue is specified and the change occurs on the main queue, the action be called synchronously, otherwise it will be dispatched asynchronously.
+ @param queue The queue on which to invoke the action, or nil to use the current queue when the change occurs (standard KVO behavior). If the change occurs on the specified queue, the action will be called synchronously, otherwise it will be dispatched asynchronously.
  @discussion On key-value change, the observer's action selector is called. The selector provided should take the form of -propertyDidChange, -propertyDidChange: or -propertyDidChange:object:, where optional parameters delivered will be KVO change dictionary and object observed. Observing nil or observing an already observed object's key path results in no operation.
  */
 - (void)observe:(nullable id)object keyPaths:(NSArray<NSString *> *)keyPaths options:(NSKeyValueObservingOptions)options action:(SEL)action queue:(nullable dispatch_queue_t)queue;
@@ -180,6 +840,85 @@ typedef void (^FBKVONotificationBlock)(id _Nullable observer, id object, NSDicti
  */
 - (void)observe:(nullable id)object keyPaths:(NSArray<NSString *> *)keyPaths options:(NSKeyValueObservingOptions)options context:(nullable void *)context;
 
+/**
+ @abstract Registers observer for aggregate change notification over a collection.
+ @param object The object owning the collection.
+ @param collectionKeyPath The key path of the collection to observe. The collection may be an NSArray, NSOrderedSet or NSSet.
+ @param elementKeyPath The numeric key path of each element to aggregate.
+ @param block The block to execute with the initial aggregate, and on every subsequent aggregate change, on the default queue.
+ @discussion Instead of recomputing @sum, @count, @avg, @min and @max over the whole collection on every change, the controller observes the collection and the element key path of each element, and maintains the aggregate incrementally. Element changes, insertions and removals are applied in constant time. Minimum and maximum are only recomputed when the last element holding the current extremum is removed or moves away from it. Use -unobserve:keyPath: with the collection key path to stop observing. Observing an already observed object collection key path or nil results in no operation.
+ */
+- (void)observe:(nullable id)object collectionKeyPath:(NSString *)collectionKeyPath elementKeyPath:(NSString *)elementKeyPath block:(FBKVOAggregateBlock)block;
+
+/**
+ @abstract Registers observer for the combined latest values of several object key paths.
+ @param objects The objects to observe.
+ @param keyPaths The key paths to observe, one per object.
+ @param queue The queue on which to invoke the block, or nil to use the controller's default queue, falling back to the main queue if the default queue is NULL.
+ @param block The block to execute with the latest values.
+ @discussion Each object is observed for the key path at the same index. Changes are coalesced: any number of changes to any of the sources results in a single block invocation on the next turn of the queue, with a snapshot of the latest value of every source. The block is first invoked with the initial values. Use -unobserve:keyPath: on each source to stop observing. Sources are observed independently of other observations of the same object key paths by the controller.
+ */
+- (void)combineLatest:(NSArray *)objects keyPaths:(NSArray<NSString *> *)keyPaths queue:(nullable dispatch_queue_t)queue block:(FBKVOCombineLatestBlock)block;
+
+/**
+ @abstract Binds a target key path to a source key path.
+ @param source The object to observe.
+ @param sourceKeyPath The key path to observe.
+ @param target The object to update. The target is not retained.
+ @param targetKeyPath The key path to update.
+ @discussion The target key path is set to the source value initially, and on every change. When both key paths are simple keys of matching type, the source getter and target setter implementations are resolved once, and values are copied directly without boxing scalars. Other key paths fall back to key-value coding. Use -unobserve:keyPath: with the source key path to unbind. Binding an already observed object key path or nil results in no operation.
+ */
+- (void)bind:(nullable id)source keyPath:(NSString *)sourceKeyPath toTarget:(id)target keyPath:(NSString *)targetKeyPath;
+
+/**
+ @abstract Binds a target key path to a transformed source key path.
+ @param source The object to observe.
+ @param sourceKeyPath The key path to observe.
+ @param target The object to update. The target is not retained.
+ @param targetKeyPath The key path to update.
+ @param transform The block transforming source values, or nil to copy values unchanged. Scalar values are boxed for transformation.
+ @discussion See -bind:keyPath:toTarget:keyPath:.
+ */
+- (void)bind:(nullable id)source keyPath:(NSString *)sourceKeyPath toTarget:(id)target keyPath:(NSString *)targetKeyPath transform:(nullable FBKVOBindingTransform)transform;
+
+/**
+ @abstract Binds two key paths to each other.
+ @param object The first object to observe and update.
+ @param keyPath The key path of the first object.
+ @param target The second object to observe and update.
+ @param targetKeyPath The key path of the second object.
+ @discussion The target key path is initially set to the object value. Afterwards, a change to either key path is applied to the other. A binding never applies the echo of its own update: updates are skipped while the same binding is applying a value on the current thread, or when the value is equal to the current value. Use -unobserve:keyPath: on both objects to unbind. Binding an already observed object key path or nil results in no operation.
+ */
+- (void)bind:(nullable id)object keyPath:(NSString *)keyPath twoWayToTarget:(id)target keyPath:(NSString *)targetKeyPath;
+
+/**
+ @abstract Registers a function for key-value change notification.
+ @param object The object to observe.
+ @param keyPath The key path to observe.
+ @param options The NSKeyValueObservingOptions to use for observation.
+ @param function The function to call on notification, synchronously on the thread of the change.
+ @param context The context passed to the function.
+ @return The observation, to unobserve or retarget, or nil if object is nil.
+ @discussion Independent of the observer and the default queue, and allocates no block. Several function observations of the same object key path are distinct, so a single controller may hold any number of them.
+ */
+- (nullable id)observe:(nullable id)object keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options function:(FBKVONotificationFunction)function context:(nullable void *)context;
+
+/**
+ @abstract Changes the context passed to the function of an observation.
+ @param context The new context.
+ @param observation The observation returned by -observe:keyPath:options:function:context:.
+ @discussion Must not be called concurrently with changes to the observed object.
+ */
+- (void)setContext:(nullable void *)context forObservation:(id)observation;
+
+/**
+ @abstract Unobserve a function observation.
+ @param object The observed object.
+ @param observation The observation returned by -observe:keyPath:options:function:context:.
+ @discussion If not observing, or unobserving nil, this method results in no operation.
+ */
+- (void)unobserve:(nullable id)object observation:(nullable id)observation;
+
 /**
  @abstract Unobserve object key path.
  @param object The object to unobserve.
@@ -195,6 +934,31 @@ typedef void (^FBKVONotificationBlock)(id _Nullable observer, id object, NSDicti
  */
 - (void)unobserve:(nullable id)object;
 
+/**
+ @abstract Registers observer for key-value change notification, registering with Foundation in the background.
+ @param object The object to observe.
+ @param keyPath The key path to observe.
+ @param options The NSKeyValueObservingOptions to use for observation.
+ @param block The block to execute on notification.
+ @discussion Returns in constant time, recording the observation immediately. Foundation registration is performed on a background serial lane of the object, retaining it until then, so changes before registration completes are not notified. The initial notification, if requested, is delivered on the lane. Registrations and asynchronous removals of the same object are performed in call order. Synchronous unobserving never waits on the lane: notifications stop immediately, and a pending registration is removed on the lane once performed. Observing an already observed object key path or nil results in no operation.
+ */
+- (void)observeAsync:(nullable id)object keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options block:(FBKVONotificationBlock)block;
+
+/**
+ @abstract Unobserve object key path, removing the Foundation registration in the background.
+ @param object The object to unobserve.
+ @param keyPath The key path to unobserve.
+ @discussion Returns in constant time. Notifications stop immediately, while Foundation removal is performed on the background serial lane of the object, retaining it until then. If not observing object key path, or unobserving nil, this method results in no operation.
+ */
+- (void)unobserveAsync:(nullable id)object keyPath:(NSString *)keyPath;
+
+/**
+ @abstract Unobserve all object key paths, removing the Foundation registrations in the background.
+ @param object The object to unobserve.
+ @discussion Returns in constant time. Notifications stop immediately, while Foundation removal is performed on the background serial lane of the object, retaining it until then. If not observing object, or unobserving nil, this method results in no operation.
+ */
+- (void)unobserveAsync:(nullable id)object;
+
 /**
  @abstract Unobserve all objects.
  @discussion If not observing any objects, this method results in no operation.
@@ -9,8 +9,11 @@
 
 #import "FBKVOController.h"
 
+#import <mach/mach_time.h>
 #import <objc/message.h>
+#import <objc/runtime.h>
 #import <pthread/pthread.h>
+#import <stdatomic.h>
 
 #if !__has_feature(objc_arc)
 #error This file must be compiled with ARC. Convert your project to ARC or specify the -fobjc-arc flag.
@@ -80,17 +83,169 @@ static NSString *describe_options(NSKeyValueObservingOptions options)
   return s;
 }
 
-static BOOL is_main_queue()
+NSString *const FBKVONotificationSequenceKey = @"FBKVONotificationSequenceKey";
+NSString *const FBKVONotificationTimestampKey = @"FBKVONotificationTimestampKey";
+
+uint64_t FBKVOTimestampNow(void)
 {
-    static dispatch_once_t onceToken;
-    dispatch_once(&onceToken, ^{
-        dispatch_queue_set_specific(dispatch_get_main_queue(), &onceToken, &onceToken, NULL);
-    });
+  static mach_timebase_info_data_t timebase;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    mach_timebase_info(&timebase);
+  });
+  return mach_absolute_time() * timebase.numer / timebase.denom;
+}
+
+static _Atomic(uint64_t) _FBKVOChangeSequence = 0;
+
+static NSDictionary<NSString *, id> *stamp_change(NSDictionary<NSString *, id> *_Nullable change, FBKVOChangeStamp stamp)
+{
+  NSMutableDictionary<NSString *, id> *stampedChange = change ? [change mutableCopy] : [NSMutableDictionary dictionary];
+  stampedChange[FBKVONotificationSequenceKey] = @(stamp.sequence);
+  stampedChange[FBKVONotificationTimestampKey] = @(stamp.timestamp);
+  return stampedChange;
+}
+
+static FBKVOChangeStamp change_stamp(NSDictionary<NSString *, id> *change)
+{
+  FBKVOChangeStamp stamp;
+  stamp.sequence = [change[FBKVONotificationSequenceKey] unsignedLongLongValue];
+  stamp.timestamp = [change[FBKVONotificationTimestampKey] unsignedLongLongValue];
+  return stamp;
+}
+
+/**
+ @abstract The absolute realtime deadline of a timeout, as taken by pthread_cond_timedwait.
+ */
+static struct timespec deadline_after(NSTimeInterval timeout)
+{
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  NSTimeInterval seconds = floor(MAX(timeout, 0));
+  deadline.tv_sec += (time_t)seconds;
+  deadline.tv_nsec += (long)((MAX(timeout, 0) - seconds) * NSEC_PER_SEC);
+  if (deadline.tv_nsec >= (long)NSEC_PER_SEC) {
+    deadline.tv_sec += 1;
+    deadline.tv_nsec -= NSEC_PER_SEC;
+  }
+  return deadline;
+}
+
+static const void *const FBKVOQueueKey = &FBKVOQueueKey;
+
+static void tag_queue(dispatch_queue_t queue)
+{
+  void *tag = (__bridge void *)queue;
+  if (tag != dispatch_queue_get_specific(queue, FBKVOQueueKey)) {
+    dispatch_queue_set_specific(queue, FBKVOQueueKey, tag, NULL);
+  }
+}
+
+static BOOL is_current_queue(dispatch_queue_t queue)
+{
+  // queues are tagged with themselves on registration, see tag_queue
+  return dispatch_get_specific(FBKVOQueueKey) == (__bridge void *)queue;
+}
+
+static dispatch_queue_t make_lane(dispatch_queue_t queue, FBKVODeliveryPriority priority)
+{
+  dispatch_queue_attr_t attr = DISPATCH_QUEUE_SERIAL;
+  const char *label = "com.facebook.FBKVOController.lane";
+
+  // quality of service is available on iOS 8 and OS X 10.10
+  if (NULL != &dispatch_queue_attr_make_with_qos_class) {
+    qos_class_t qos = QOS_CLASS_DEFAULT;
+    switch (priority) {
+      case FBKVODeliveryPriorityHigh:
+        qos = QOS_CLASS_USER_INTERACTIVE;
+        label = "com.facebook.FBKVOController.lane.high";
+        break;
+      case FBKVODeliveryPriorityLow:
+        qos = QOS_CLASS_UTILITY;
+        label = "com.facebook.FBKVOController.lane.low";
+        break;
+      case FBKVODeliveryPriorityBackground:
+        qos = QOS_CLASS_BACKGROUND;
+        label = "com.facebook.FBKVOController.lane.background";
+        break;
+      case FBKVODeliveryPriorityDefault:
+        break;
+    }
+    attr = dispatch_queue_attr_make_with_qos_class(attr, qos, 0);
+  }
+
+  dispatch_queue_t lane = dispatch_queue_create(label, attr);
+  dispatch_set_target_queue(lane, queue);
+  return lane;
+}
+
+// registration lanes, a power of two; objects are striped across lanes by address
+#define FBKVO_REGISTRATION_LANE_COUNT 16
+
+static dispatch_queue_t registration_lane(id object)
+{
+  static dispatch_queue_t lanes[FBKVO_REGISTRATION_LANE_COUNT];
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    dispatch_queue_attr_t attr = DISPATCH_QUEUE_SERIAL;
+    // quality of service is available on iOS 8 and OS X 10.10, the low priority global queue everywhere
+    if (NULL != &dispatch_queue_attr_make_with_qos_class) {
+      attr = dispatch_queue_attr_make_with_qos_class(attr, QOS_CLASS_UTILITY, 0);
+    }
+    dispatch_queue_t target = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0);
+    for (NSUInteger idx = 0; idx < FBKVO_REGISTRATION_LANE_COUNT; idx++) {
+      lanes[idx] = dispatch_queue_create("com.facebook.FBKVOController.registration", attr);
+      dispatch_set_target_queue(lanes[idx], target);
+    }
+  });
 
-    return dispatch_get_specific(&onceToken) == &onceToken;
+  // registrations of an object are serialized on one lane, in order
+  uintptr_t address = (uintptr_t)(__bridge void *)object;
+  return lanes[(address >> 4) & (FBKVO_REGISTRATION_LANE_COUNT - 1)];
 }
 
 @class _FBKVOInfo;
+@class _FBKVOBufferedNotification;
+@class _FBKVOFrameSampler;
+@class _FBKVOMailbox;
+@class _FBKVOWorkerPool;
+
+typedef NS_ENUM(uint8_t, _FBKVOPauseState) {
+  _FBKVOPauseStateNone = 0,
+
+  // notifications are dropped
+  _FBKVOPauseStateDropping,
+
+  // the latest notifications are buffered until resume
+  _FBKVOPauseStateRetaining,
+};
+
+// changes retained per paused observation before collapsing into a single setting
+#define FBKVO_PAUSED_CHANGES_LIMIT 64
+
+@interface FBKVOController ()
+{
+@public
+  // checked by the shared controller on every notification
+  _Atomic(uint8_t) _pauseState;
+  // serializes callbacks once set, created once and kept until deallocation
+  _Atomic(bool) _serial;
+  _FBKVOMailbox *_actor;
+  // deliveries enqueued but not yet run
+  _Atomic(intptr_t) _inflight;
+  // guards flush completions, signaled when no delivery is in flight
+  pthread_mutex_t _flushMutex;
+  pthread_cond_t _flushCondition;
+  NSMutableArray<dispatch_block_t> *_flushCompletions;
+}
+
+/** unobserve a registered info */
+- (void)_unobserve:(id)object info:(_FBKVOInfo *)info;
+
+/** buffer a notification received while paused */
+- (BOOL)_withholdNotificationForInfo:(_FBKVOInfo *)info object:(nullable id)object keyPath:(nullable NSString *)keyPath change:(nullable NSDictionary<NSString *, id> *)change;
+
+@end
 
 /**
  @abstract The shared KVO controller instance.
@@ -110,8 +265,281 @@ static BOOL is_main_queue()
 /** unobserve an object with a set of infos */
 - (void)unobserve:(id)object infos:(nullable NSSet *)infos;
 
+/** unobserve an object with a set of infos immediately, removing Foundation observers later on the registration lane of object */
+- (void)unobserveAsync:(id)object infos:(nullable NSSet *)infos;
+
+/** whether an info is currently registered */
+- (BOOL)isObservingInfo:(_FBKVOInfo *)info;
+
+/** notify buffered notifications of infos still registered */
+- (void)notifyBufferedNotifications:(NSArray<_FBKVOBufferedNotification *> *)entries;
+
+/** notify the observer of an info, on its queue */
+- (void)notifyInfo:(_FBKVOInfo *)info object:(nullable id)object keyPath:(nullable NSString *)keyPath change:(nullable NSDictionary<NSString *, id> *)change;
+
 @property (nonatomic, nullable) dispatch_queue_t defaultQueue;
 
+/** the mailbox delivering to queue, shared while retained by infos or a pending drain */
+- (_FBKVOMailbox *)mailboxForQueue:(dispatch_queue_t)queue;
+
+/** a serial queue targeting queue, delivering at priority */
+- (dispatch_queue_t)laneForQueue:(dispatch_queue_t)queue priority:(FBKVODeliveryPriority)priority;
+
+/** maximum nesting depth of synchronous notifications per thread */
+@property (atomic) NSUInteger maximumDepth;
+
+/** called with the key paths of a detected notification cycle */
+@property (atomic, copy, nullable) void (^cycleHandler)(NSArray<NSString *> *keyPaths);
+
+@end
+
+#pragma mark _FBKVOBinding -
+
+static const char *skip_type_qualifiers(const char *type)
+{
+  while ('\0' != *type && NULL != strchr("rnNoORV", *type)) {
+    type++;
+  }
+  return type;
+}
+
+static SEL property_accessor(Class cls, NSString *key, const char *attribute, BOOL setter)
+{
+  objc_property_t property = class_getProperty(cls, key.UTF8String);
+  if (NULL != property) {
+    char *name = property_copyAttributeValue(property, attribute);
+    if (NULL != name) {
+      SEL sel = sel_registerName(name);
+      free(name);
+      return sel;
+    }
+  }
+  if (!setter) {
+    return NSSelectorFromString(key);
+  }
+  NSString *first = [[key substringToIndex:1] uppercaseString];
+  return NSSelectorFromString([NSString stringWithFormat:@"set%@%@:", first, [key substringFromIndex:1]]);
+}
+
+/**
+ @abstract Shared by the two directions of a two-way binding, to suppress echoes.
+ */
+@interface _FBKVOBindingGuard : NSObject
+@end
+
+@implementation _FBKVOBindingGuard
+{
+@public
+  // the thread currently applying a value, if any
+  _Atomic(pthread_t) _thread;
+}
+@end
+
+/**
+ @abstract A one-way binding from a source key path to a target key path.
+ @discussion Resolves the source getter and target setter implementations up front, so that scalar values are copied without boxing.
+ */
+@interface _FBKVOBinding : NSObject
+@end
+
+@implementation _FBKVOBinding
+{
+@public
+  __weak id _target;
+  NSString *_sourceKeyPath;
+  NSString *_targetKeyPath;
+  FBKVOBindingTransform _transform;
+
+  // resolved implementations, valid for the cached classes
+  Class _sourceClass;
+  Class _targetClass;
+  SEL _getter;
+  SEL _setter;
+  IMP _getterIMP;
+  IMP _setterIMP;
+  // type encoding of the bound value, or zero to fall back to key-value coding
+  char _type;
+
+  // whether to skip setting values equal to the current target value
+  BOOL _compares;
+  SEL _targetGetter;
+  IMP _targetGetterIMP;
+  _FBKVOBindingGuard *_guard;
+}
+
+- (instancetype)initWithTarget:(id)target sourceKeyPath:(NSString *)sourceKeyPath targetKeyPath:(NSString *)targetKeyPath transform:(nullable FBKVOBindingTransform)transform
+{
+  self = [super init];
+  if (nil != self) {
+    _target = target;
+    _sourceKeyPath = [sourceKeyPath copy];
+    _targetKeyPath = [targetKeyPath copy];
+    _transform = [transform copy];
+  }
+  return self;
+}
+
+- (void)resolveSource:(id)source target:(id)target
+{
+  _sourceClass = object_getClass(source);
+  _targetClass = object_getClass(target);
+  _type = 0;
+
+  // key paths traverse objects; only direct keys are resolved
+  if (NSNotFound != [_sourceKeyPath rangeOfString:@"."].location || NSNotFound != [_targetKeyPath rangeOfString:@"."].location) {
+    return;
+  }
+
+  _getter = property_accessor(_sourceClass, _sourceKeyPath, "G", NO);
+  _setter = property_accessor(_targetClass, _targetKeyPath, "S", YES);
+  Method getter = class_getInstanceMethod(_sourceClass, _getter);
+  Method setter = class_getInstanceMethod(_targetClass, _setter);
+  if (NULL == getter || NULL == setter || 3 != method_getNumberOfArguments(setter)) {
+    return;
+  }
+
+  char getterType[16];
+  char setterType[16];
+  method_getReturnType(getter, getterType, sizeof(getterType));
+  method_getArgumentType(setter, 2, setterType, sizeof(setterType));
+  const char *type = skip_type_qualifiers(getterType);
+  if (type[0] != skip_type_qualifiers(setterType)[0]) {
+    return;
+  }
+
+  Method targetGetter = NULL;
+  if (_compares) {
+    _targetGetter = property_accessor(_targetClass, _targetKeyPath, "G", NO);
+    targetGetter = class_getInstanceMethod(_targetClass, _targetGetter);
+    if (NULL == targetGetter) {
+      return;
+    }
+    char targetGetterType[16];
+    method_getReturnType(targetGetter, targetGetterType, sizeof(targetGetterType));
+    if (type[0] != skip_type_qualifiers(targetGetterType)[0]) {
+      return;
+    }
+  }
+
+  char code = type[0];
+  if (NULL != _transform && '@' != code) {
+    // transforms operate on objects
+    return;
+  }
+  if ('\0' == code || NULL == strchr("cCsSiIlLqQfdB@#", code)) {
+    // structs and other types fall back to key-value coding
+    return;
+  }
+
+  _getterIMP = method_getImplementation(getter);
+  _setterIMP = method_getImplementation(setter);
+  _targetGetterIMP = NULL != targetGetter ? method_getImplementation(targetGetter) : NULL;
+  _type = code;
+}
+
+static inline BOOL binding_floating_equal(double a, double b)
+{
+  // NaN never compares equal, yet setting it again is no change
+  return a == b || (isnan(a) && isnan(b));
+}
+
+#define FBKVO_BINDING_EQUAL(A, B) ((A) == (B))
+
+#define FBKVO_BINDING_COPY(TYPE, EQUAL) { \
+  TYPE value = ((TYPE (*)(id, SEL))_getterIMP)(source, _getter); \
+  if (!_compares || !EQUAL(value, ((TYPE (*)(id, SEL))_targetGetterIMP)(target, _targetGetter))) { \
+    ((void (*)(id, SEL, TYPE))_setterIMP)(target, _setter, value); \
+  } \
+}
+
+- (void)applyFromSource:(id)source
+{
+  // take strong reference to target
+  id target = _target;
+  if (nil == target) {
+    return;
+  }
+
+  // suppress the echo of a value this binding pair is applying on the current thread
+  BOOL guarded = NO;
+  if (nil != _guard) {
+    pthread_t thread = pthread_self();
+    pthread_t applying = atomic_load_explicit(&_guard->_thread, memory_order_acquire);
+    if (NULL != applying && pthread_equal(applying, thread)) {
+      return;
+    }
+    pthread_t none = NULL;
+    guarded = atomic_compare_exchange_strong(&_guard->_thread, &none, thread);
+  }
+
+  [self _applyFromSource:source target:target];
+
+  if (guarded) {
+    atomic_store_explicit(&_guard->_thread, (pthread_t)NULL, memory_order_release);
+  }
+}
+
+- (void)_applyFromSource:(id)source target:(id)target
+{
+  // implementations change when observation subclasses objects
+  if (object_getClass(source) != _sourceClass || object_getClass(target) != _targetClass) {
+    [self resolveSource:source target:target];
+  }
+
+  switch (_type) {
+    case 'c': FBKVO_BINDING_COPY(char, FBKVO_BINDING_EQUAL); break;
+    case 'C': FBKVO_BINDING_COPY(unsigned char, FBKVO_BINDING_EQUAL); break;
+    case 's': FBKVO_BINDING_COPY(short, FBKVO_BINDING_EQUAL); break;
+    case 'S': FBKVO_BINDING_COPY(unsigned short, FBKVO_BINDING_EQUAL); break;
+    case 'i': FBKVO_BINDING_COPY(int, FBKVO_BINDING_EQUAL); break;
+    case 'I': FBKVO_BINDING_COPY(unsigned int, FBKVO_BINDING_EQUAL); break;
+    case 'l': FBKVO_BINDING_COPY(long, FBKVO_BINDING_EQUAL); break;
+    case 'L': FBKVO_BINDING_COPY(unsigned long, FBKVO_BINDING_EQUAL); break;
+    case 'q': FBKVO_BINDING_COPY(long long, FBKVO_BINDING_EQUAL); break;
+    case 'Q': FBKVO_BINDING_COPY(unsigned long long, FBKVO_BINDING_EQUAL); break;
+    case 'f': FBKVO_BINDING_COPY(float, binding_floating_equal); break;
+    case 'd': FBKVO_BINDING_COPY(double, binding_floating_equal); break;
+    case 'B': FBKVO_BINDING_COPY(bool, FBKVO_BINDING_EQUAL); break;
+    case '@':
+    case '#': {
+      id value = ((id (*)(id, SEL))_getterIMP)(source, _getter);
+      if (NULL != _transform) {
+        value = _transform(value);
+      }
+      if (_compares) {
+        id current = ((id (*)(id, SEL))_targetGetterIMP)(target, _targetGetter);
+        if (value == current || [value isEqual:current]) {
+          break;
+        }
+      }
+      ((void (*)(id, SEL, id))_setterIMP)(target, _setter, value);
+      break;
+    }
+    default: {
+      id value = [source valueForKeyPath:_sourceKeyPath];
+      if (NULL != _transform) {
+        value = _transform(value);
+      }
+      if (_compares) {
+        id current = [target valueForKeyPath:_targetKeyPath];
+        if (value == current || [value isEqual:current]) {
+          break;
+        }
+      }
+      [target setValue:value forKeyPath:_targetKeyPath];
+      break;
+    }
+  }
+}
+
+#undef FBKVO_BINDING_COPY
+#undef FBKVO_BINDING_EQUAL
+
+- (NSString *)debugDescription
+{
+  return [NSString stringWithFormat:@"<%@:%p target:%@ keyPath:%@ type:%c>", NSStringFromClass([self class]), self, _target, _targetKeyPath, _type ?: '?'];
+}
+
 @end
 
 #pragma mark _FBKVOInfo -
@@ -134,6 +562,8 @@ typedef NS_ENUM(uint8_t, _FBKVOInfoState) {
 @interface _FBKVOInfo : NSObject
 @end
 
+static _Atomic(uint64_t) _FBKVOInfoOrder = 0;
+
 @implementation _FBKVOInfo
 {
 @public
@@ -144,7 +574,34 @@ typedef NS_ENUM(uint8_t, _FBKVOInfoState) {
   dispatch_queue_t _queue;
   void *_context;
   FBKVONotificationBlock _block;
-  _FBKVOInfoState _state;
+  // an _FBKVOInfoState, swapped atomically as registration and removal may race
+  _Atomic(uint8_t) _state;
+  // registration order, used to order deferred notifications
+  uint64_t _order;
+  _FBKVOBinding *_binding;
+  _FBKVOFrameSampler *_sampler;
+  _Atomic(uint8_t) _pauseState;
+  // serial queue targeting queue, prioritizing delivery
+  dispatch_queue_t _lane;
+  // mailbox of the delivery queue, resolved on registration
+  _FBKVOMailbox *_mailbox;
+  // runs deliveries in place of queue
+  id<FBKVOExecutor> _executor;
+  // changes are stamped on receipt
+  BOOL _stamped;
+  // Foundation registration happens on the registration lane of the object
+  BOOL _async;
+  // limited observations count down remaining deliveries, removing themselves on the last
+  BOOL _limited;
+  _Atomic(NSUInteger) _remaining;
+  // buffers changes in place of delivery
+  FBKVOStream *_stream;
+  // subscribers of an observable property, registered with in place of Foundation
+  FBKVOObservableSubscribers *_subscribers;
+  // the combiner of a combined source, distinguishing it from other observations of the key path
+  id _group;
+  // called with context in place of a block, each function observation being distinct
+  FBKVONotificationFunction _function;
 }
 
 - (instancetype)initWithController:(FBKVOController *)controller
@@ -164,13 +621,14 @@ typedef NS_ENUM(uint8_t, _FBKVOInfoState) {
     _action = action;
     _queue = queue;
     _context = context;
+    _order = atomic_fetch_add_explicit(&_FBKVOInfoOrder, 1, memory_order_relaxed);
   }
   return self;
 }
 
 - (instancetype)initWithController:(FBKVOController *)controller keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options block:(FBKVONotificationBlock)block
 {
-  return [self initWithController:controller keyPath:keyPath options:options block:block action:NULL queue:[_FBKVOSharedController sharedController].defaultQueue context:NULL];
+  return [self initWithController:controller keyPath:keyPath options:options block:block action:NULL queue:controller.defaultQueue context:NULL];
 }
 
 - (instancetype)initWithController:(FBKVOController *)controller keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options action:(SEL)action queue:(nullable dispatch_queue_t)queue
@@ -180,12 +638,12 @@ typedef NS_ENUM(uint8_t, _FBKVOInfoState) {
 
 - (instancetype)initWithController:(FBKVOController *)controller keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options context:(void *)context
 {
-  return [self initWithController:controller keyPath:keyPath options:options block:NULL action:NULL queue:[_FBKVOSharedController sharedController].defaultQueue context:context];
+  return [self initWithController:controller keyPath:keyPath options:options block:NULL action:NULL queue:controller.defaultQueue context:context];
 }
 
 - (instancetype)initWithController:(FBKVOController *)controller keyPath:(NSString *)keyPath
 {
-  return [self initWithController:controller keyPath:keyPath options:0 block:NULL action:NULL queue:[_FBKVOSharedController sharedController].defaultQueue context:NULL];
+  return [self initWithController:controller keyPath:keyPath options:0 block:NULL action:NULL queue:controller.defaultQueue context:NULL];
 }
 
 - (NSUInteger)hash
@@ -204,7 +662,10 @@ typedef NS_ENUM(uint8_t, _FBKVOInfoState) {
   if (![object isKindOfClass:[self class]]) {
     return NO;
   }
-  return [_keyPath isEqualToString:((_FBKVOInfo *)object)->_keyPath];
+  if (NULL != _function || NULL != ((_FBKVOInfo *)object)->_function) {
+    return NO;
+  }
+  return _group == ((_FBKVOInfo *)object)->_group && [_keyPath isEqualToString:((_FBKVOInfo *)object)->_keyPath];
 }
 
 - (NSString *)debugDescription
@@ -219,203 +680,2696 @@ typedef NS_ENUM(uint8_t, _FBKVOInfoState) {
   if (NULL != _queue) {
     [s appendFormat:@" queue:%s", dispatch_queue_get_label(_queue)];
   }
+  if (NULL != _lane) {
+    [s appendFormat:@" lane:%s", dispatch_queue_get_label(_lane)];
+  }
   if (NULL != _context) {
     [s appendFormat:@" context:%p", _context];
   }
   if (NULL != _block) {
     [s appendFormat:@" block:%p", _block];
   }
+  if (NULL != _function) {
+    [s appendFormat:@" function:%p", _function];
+  }
+  if (nil != _binding) {
+    [s appendFormat:@" binding:%@", _binding.debugDescription];
+  }
+  if (nil != _executor) {
+    [s appendFormat:@" executor:<%@:%p>", NSStringFromClass([_executor class]), _executor];
+  }
   [s appendString:@">"];
   return s;
 }
 
 @end
 
-#pragma mark _FBKVOSharedController -
+#pragma mark _FBKVONotificationBuffer -
 
-@implementation _FBKVOSharedController
+/**
+ @abstract Coalesces two consecutive value settings into one, carrying the first old value and the last new value.
+ @return The coalesced change, or nil if either change is not a setting.
+ */
+static NSDictionary<NSString *, id> *_Nullable coalesce_changes(NSDictionary<NSString *, id> *_Nullable earlier, NSDictionary<NSString *, id> *_Nullable later)
 {
-  NSHashTable<_FBKVOInfo *> *_infos;
-  pthread_mutex_t _mutex;
+  if (nil == earlier || nil == later
+      || NSKeyValueChangeSetting != [earlier[NSKeyValueChangeKindKey] unsignedIntegerValue]
+      || NSKeyValueChangeSetting != [later[NSKeyValueChangeKindKey] unsignedIntegerValue]) {
+    return nil;
+  }
+
+  NSMutableDictionary<NSString *, id> *coalescedChange = [later mutableCopy];
+  id oldValue = earlier[NSKeyValueChangeOldKey];
+  if (nil != oldValue) {
+    coalescedChange[NSKeyValueChangeOldKey] = oldValue;
+  } else {
+    [coalescedChange removeObjectForKey:NSKeyValueChangeOldKey];
+  }
+  return coalescedChange;
 }
 
-+ (instancetype)sharedController
+/**
+ @abstract Notifications buffered for a single info.
+ */
+@interface _FBKVOBufferedNotification : NSObject
+@end
+
+@implementation _FBKVOBufferedNotification
 {
-  static _FBKVOSharedController *_controller = nil;
-  static dispatch_once_t onceToken;
-  dispatch_once(&onceToken, ^{
-    _controller = [[_FBKVOSharedController alloc] init];
-  });
-  return _controller;
+@public
+  _FBKVOInfo *_info;
+  id _object;
+  NSString *_keyPath;
+  NSDictionary<NSString *, id> *_priorChange;
+  NSMutableArray<NSDictionary<NSString *, id> *> *_changes;
+  // past the buffer limit, changes collapse into a setting of the value current at delivery
+  BOOL _collapsed;
+}
+@end
+
+/**
+ @abstract The setting change standing for collapsed changes, carrying the current value.
+ */
+static NSDictionary<NSString *, id> *collapsed_change(NSKeyValueObservingOptions options, id _Nullable object, NSString *_Nullable keyPath)
+{
+  NSMutableDictionary<NSString *, id> *change = [NSMutableDictionary dictionaryWithObject:@(NSKeyValueChangeSetting) forKey:NSKeyValueChangeKindKey];
+  if (0 != (options & NSKeyValueObservingOptionNew) && nil != keyPath) {
+    change[NSKeyValueChangeNewKey] = [object valueForKeyPath:keyPath] ?: [NSNull null];
+  }
+  return change;
+}
+
+/**
+ @abstract Buffers notifications, coalescing them per info.
+ @discussion Used by per-thread transactions until commit, and by paused observations until resume.
+ */
+@interface _FBKVONotificationBuffer : NSObject
+@end
+
+@implementation _FBKVONotificationBuffer
+{
+  NSMapTable<_FBKVOInfo *, _FBKVOBufferedNotification *> *_entries;
+  // maximum number of changes buffered per info, zero meaning unlimited
+  NSUInteger _limit;
 }
 
 - (instancetype)init
+{
+  return [self initWithLimit:0];
+}
+
+- (instancetype)initWithLimit:(NSUInteger)limit
 {
   self = [super init];
   if (nil != self) {
-    NSHashTable *infos = [NSHashTable alloc];
-#ifdef __IPHONE_OS_VERSION_MIN_REQUIRED
-    _infos = [infos initWithOptions:NSPointerFunctionsWeakMemory|NSPointerFunctionsObjectPointerPersonality capacity:0];
-#elif defined(__MAC_OS_X_VERSION_MIN_REQUIRED)
-    if ([NSHashTable respondsToSelector:@selector(weakObjectsHashTable)]) {
-      _infos = [infos initWithOptions:NSPointerFunctionsWeakMemory|NSPointerFunctionsObjectPointerPersonality capacity:0];
-    } else {
-      // silence deprecated warnings
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wdeprecated-declarations"
-      _infos = [infos initWithOptions:NSPointerFunctionsZeroingWeakMemory|NSPointerFunctionsObjectPointerPersonality capacity:0];
-#pragma clang diagnostic pop
-    }
-
-#endif
-    pthread_mutex_init(&_mutex, NULL);
+    _entries = [[NSMapTable alloc] initWithKeyOptions:NSPointerFunctionsStrongMemory|NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory|NSPointerFunctionsObjectPersonality capacity:0];
+    _limit = limit;
   }
   return self;
 }
 
-- (void)dealloc
+- (void)addInfo:(_FBKVOInfo *)info object:(nullable id)object keyPath:(nullable NSString *)keyPath change:(nullable NSDictionary<NSString *, id> *)change
 {
-  pthread_mutex_destroy(&_mutex);
-}
+  _FBKVOBufferedNotification *entry = [_entries objectForKey:info];
+  if (nil == entry) {
+    entry = [[_FBKVOBufferedNotification alloc] init];
+    entry->_info = info;
+    entry->_object = object;
+    entry->_keyPath = keyPath;
+    entry->_changes = [NSMutableArray array];
+    [_entries setObject:entry forKey:info];
+  }
 
-- (NSString *)debugDescription
-{
-  NSMutableString *s = [NSMutableString stringWithFormat:@"<%@:%p", NSStringFromClass([self class]), self];
+  if ([change[NSKeyValueChangeNotificationIsPriorKey] boolValue]) {
+    // keep the first prior notification only
+    if (nil == entry->_priorChange) {
+      entry->_priorChange = change;
+    }
+    return;
+  }
 
-  // lock
-  pthread_mutex_lock(&_mutex);
+  if (entry->_collapsed) {
+    return;
+  }
 
-  NSMutableArray *infoDescriptions = [NSMutableArray arrayWithCapacity:_infos.count];
-  for (_FBKVOInfo *info in _infos) {
-    [infoDescriptions addObject:info.debugDescription];
+  NSDictionary<NSString *, id> *coalescedChange = coalesce_changes(entry->_changes.lastObject, change);
+  if (nil != coalescedChange) {
+    entry->_changes[entry->_changes.count - 1] = coalescedChange;
+  } else {
+    [entry->_changes addObject:change ?: @{}];
   }
 
-  [s appendFormat:@" contexts:%@", infoDescriptions];
+  // bound memory of changes that do not coalesce, such as collection mutations
+  if (0 != _limit && entry->_changes.count > _limit) {
+    [entry->_changes removeAllObjects];
+    entry->_collapsed = YES;
+  }
+}
 
-  // unlock
-  pthread_mutex_unlock(&_mutex);
+- (BOOL)isEmpty
+{
+  return 0 == _entries.count;
+}
 
-  [s appendString:@">"];
-  return s;
+- (NSArray<_FBKVOBufferedNotification *> *)sortedEntries
+{
+  return [self takeSortedEntriesPassingTest:^BOOL(_FBKVOInfo *info) {
+    return YES;
+  }];
 }
 
-- (void)observe:(id)object info:(nullable _FBKVOInfo *)info
+- (NSArray<_FBKVOBufferedNotification *> *)takeSortedEntriesPassingTest:(BOOL (^)(_FBKVOInfo *info))predicate
 {
-  if (nil == info) {
-    return;
+  NSMutableArray<_FBKVOBufferedNotification *> *entries = [NSMutableArray array];
+  for (_FBKVOInfo *info in [_entries keyEnumerator].allObjects) {
+    if (predicate(info)) {
+      [entries addObject:[_entries objectForKey:info]];
+      [_entries removeObjectForKey:info];
+    }
+  }
+  [entries sortUsingComparator:^NSComparisonResult(_FBKVOBufferedNotification *entry1, _FBKVOBufferedNotification *entry2) {
+    uint64_t order1 = entry1->_info->_order;
+    uint64_t order2 = entry2->_info->_order;
+    return order1 < order2 ? NSOrderedAscending : (order1 > order2 ? NSOrderedDescending : NSOrderedSame);
+  }];
+  return entries;
+}
+
+@end
+
+/**
+ @abstract A notification whose delivery was deferred to avoid deep recursion.
+ */
+@interface _FBKVODeferredNotification : NSObject
+@end
+
+@implementation _FBKVODeferredNotification
+{
+@public
+  _FBKVOInfo *_info;
+  id _object;
+  NSString *_keyPath;
+  NSDictionary<NSString *, id> *_change;
+}
+@end
+
+/**
+ @abstract Consecutive deliveries of one observation, enqueued on an executor at once.
+ */
+@interface _FBKVOExecutorBatch : NSObject
+@end
+
+@implementation _FBKVOExecutorBatch
+{
+@public
+  id<FBKVOExecutor> _executor;
+  _FBKVOInfo *_info;
+  NSMutableArray<dispatch_block_t> *_blocks;
+}
+@end
+
+/**
+ @abstract Per-thread notification state.
+ */
+@interface _FBKVOThreadState : NSObject
+@end
+
+@implementation _FBKVOThreadState
+{
+@public
+  // notifications buffered by the current transaction, if any
+  _FBKVONotificationBuffer *_transaction;
+  NSUInteger _transactionDepth;
+  // nesting depth of synchronous notifications
+  NSUInteger _depth;
+  // infos currently being delivered, outermost first
+  NSMutableArray<_FBKVOInfo *> *_stack;
+  // notifications deferred past the maximum depth, delivered once the outermost notification unwinds
+  NSMutableArray<_FBKVODeferredNotification *> *_deferred;
+  BOOL _cycleReported;
+  // executor deliveries collected while delivering buffered notifications
+  NSUInteger _batchDepth;
+  NSMutableArray<_FBKVOExecutorBatch *> *_batches;
+  // pool of the current worker thread, if any
+  __unsafe_unretained _FBKVOWorkerPool *_pool;
+  NSUInteger _workerIndex;
+  // the controller delivering retained notifications on resume, and the infos it resumes
+  __unsafe_unretained FBKVOController *_resumingController;
+  BOOL (^_resumingPredicate)(_FBKVOInfo *info);
+  // the stamp of the change being fanned out to stamped infos, and the infos it was given to
+  __weak id _stampedObject;
+  NSString *_stampedKeyPath;
+  FBKVOChangeStamp _stamp;
+  NSHashTable<_FBKVOInfo *> *_stampedInfos;
+}
+
+- (instancetype)init
+{
+  self = [super init];
+  if (nil != self) {
+    _stack = [NSMutableArray array];
+    _deferred = [NSMutableArray array];
+    _batches = [NSMutableArray array];
+    _stampedInfos = [[NSHashTable alloc] initWithOptions:NSPointerFunctionsWeakMemory|NSPointerFunctionsObjectPointerPersonality capacity:0];
+  }
+  return self;
+}
+
+@end
+
+static void thread_state_destructor(void *state)
+{
+  CFRelease(state);
+}
+
+static pthread_key_t thread_state_key()
+{
+  static pthread_key_t key;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    pthread_key_create(&key, thread_state_destructor);
+  });
+  return key;
+}
+
+static _FBKVOThreadState *current_thread_state()
+{
+  pthread_key_t key = thread_state_key();
+  _FBKVOThreadState *state = (__bridge _FBKVOThreadState *)pthread_getspecific(key);
+  if (nil == state) {
+    state = [[_FBKVOThreadState alloc] init];
+    pthread_setspecific(key, (__bridge_retained void *)state);
+  }
+  return state;
+}
+
+#pragma mark FBKVODispatchFrameClock -
+
+@implementation FBKVODispatchFrameClock
+{
+  dispatch_queue_t _queue;
+  dispatch_source_t _timer;
+  uint64_t _interval;
+  NSMutableArray<dispatch_block_t> *_blocks;
+  BOOL _running;
+  pthread_mutex_t _mutex;
+}
+
++ (instancetype)sharedClock
+{
+  static FBKVODispatchFrameClock *_clock = nil;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    _clock = [[FBKVODispatchFrameClock alloc] initWithQueue:dispatch_get_main_queue() framesPerSecond:60];
+  });
+  return _clock;
+}
+
+- (instancetype)initWithQueue:(dispatch_queue_t)queue framesPerSecond:(NSUInteger)framesPerSecond
+{
+  NSParameterAssert(queue);
+  self = [super init];
+  if (nil != self) {
+    _queue = queue;
+    _interval = NSEC_PER_SEC / MAX(framesPerSecond, 1u);
+    _blocks = [NSMutableArray array];
+    _timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, queue);
+    __weak FBKVODispatchFrameClock *weakSelf = self;
+    dispatch_source_set_event_handler(_timer, ^{
+      [weakSelf _tick];
+    });
+    pthread_mutex_init(&_mutex, NULL);
+  }
+  return self;
+}
+
+- (void)dealloc
+{
+  // a suspended source must be resumed before release
+  if (!_running) {
+    dispatch_resume(_timer);
+  }
+  dispatch_source_cancel(_timer);
+  pthread_mutex_destroy(&_mutex);
+}
+
+- (void)performOnNextFrame:(dispatch_block_t)block
+{
+  pthread_mutex_lock(&_mutex);
+  [_blocks addObject:[block copy]];
+  if (!_running) {
+    // the timer only runs while frames are requested
+    _running = YES;
+    dispatch_source_set_timer(_timer, dispatch_time(DISPATCH_TIME_NOW, (int64_t)_interval), _interval, _interval / 10);
+    dispatch_resume(_timer);
+  }
+  pthread_mutex_unlock(&_mutex);
+}
+
+- (void)_tick
+{
+  pthread_mutex_lock(&_mutex);
+  NSArray<dispatch_block_t> *blocks = _blocks;
+  _blocks = [NSMutableArray array];
+  if (0 == blocks.count && _running) {
+    _running = NO;
+    dispatch_suspend(_timer);
+  }
+  pthread_mutex_unlock(&_mutex);
+
+  for (dispatch_block_t block in blocks) {
+    block();
+  }
+}
+
+@end
+
+#pragma mark _FBKVOFrameSampler -
+
+static dispatch_block_t counted_block(FBKVOController *controller, dispatch_block_t delivery);
+
+/**
+ @abstract Samples the latest change of an info, delivering it at most once per frame.
+ */
+@interface _FBKVOFrameSampler : NSObject
+@end
+
+@implementation _FBKVOFrameSampler
+{
+@public
+  __weak _FBKVOInfo *_info;
+  id<FBKVOFrameClock> _clock;
+  id _object;
+  NSDictionary<NSString *, id> *_change;
+  BOOL _scheduled;
+  pthread_mutex_t _mutex;
+}
+
+- (instancetype)initWithClock:(id<FBKVOFrameClock>)clock
+{
+  self = [super init];
+  if (nil != self) {
+    _clock = clock;
+    pthread_mutex_init(&_mutex, NULL);
+  }
+  return self;
+}
+
+- (void)dealloc
+{
+  pthread_mutex_destroy(&_mutex);
+}
+
+- (void)sampleObject:(nullable id)object change:(nullable NSDictionary<NSString *, id> *)change controller:(FBKVOController *)controller
+{
+  // only the settled value is sampled
+  if ([change[NSKeyValueChangeNotificationIsPriorKey] boolValue]) {
+    return;
+  }
+
+  pthread_mutex_lock(&_mutex);
+  _change = coalesce_changes(_change, change) ?: change;
+  _object = object;
+  BOOL schedule = !_scheduled;
+  _scheduled = YES;
+  pthread_mutex_unlock(&_mutex);
+
+  if (schedule) {
+    // in flight until the frame, for flushes
+    __weak _FBKVOFrameSampler *weakSelf = self;
+    [_clock performOnNextFrame:counted_block(controller, ^{
+      [weakSelf _deliver];
+    })];
+  }
+}
+
+- (void)_deliver
+{
+  pthread_mutex_lock(&_mutex);
+  id object = _object;
+  NSDictionary<NSString *, id> *change = _change;
+  _object = nil;
+  _change = nil;
+  _scheduled = NO;
+  pthread_mutex_unlock(&_mutex);
+
+  // take strong reference to info, and skip if unobserved
+  _FBKVOInfo *info = _info;
+  if (nil == info || ![[_FBKVOSharedController sharedController] isObservingInfo:info]) {
+    return;
+  }
+
+  // take strong references to controller and observer
+  FBKVOController *controller = info->_controller;
+  id observer = controller.observer;
+  if (nil != observer) {
+    info->_block(observer, object, change);
+  }
+}
+
+@end
+
+#pragma mark _FBKVOMailbox -
+
+typedef struct _FBKVOMailboxNode {
+  _Atomic(struct _FBKVOMailboxNode *) next;
+  // retained delivery block
+  void *block;
+} _FBKVOMailboxNode;
+
+// deliveries run per drain before yielding the queue to other work
+static const NSUInteger FBKVOMailboxDrainBatch = 256;
+
+@class _FBKVOWorkerPool;
+
+/**
+ @abstract A multi-producer, single-consumer queue of deliveries for a dispatch queue or worker pool.
+ @discussion Producers push without locking. At most one drain is scheduled on the queue or pool while the mailbox is non-empty, so a burst of changes costs a single dispatch, and deliveries run in push order without overlapping.
+ */
+@interface _FBKVOMailbox : NSObject
+@end
+
+static void pool_submit(_FBKVOWorkerPool *pool, _FBKVOMailbox *mailbox);
+
+@implementation _FBKVOMailbox
+{
+@public
+  dispatch_queue_t _queue;
+  // pool draining the mailbox in place of queue
+  _FBKVOWorkerPool *_pool;
+  // most recently pushed node, swapped by producers
+  _Atomic(_FBKVOMailboxNode *) _head;
+  // consumed node preceding the oldest pending node, owned by the drain
+  _FBKVOMailboxNode *_tail;
+  _FBKVOMailboxNode _stub;
+  // pushed but not yet run deliveries
+  _Atomic(intptr_t) _count;
+}
+
+- (instancetype)initWithQueue:(dispatch_queue_t)queue
+{
+  self = [super init];
+  if (nil != self) {
+    _queue = queue;
+    atomic_init(&_stub.next, NULL);
+    _stub.block = NULL;
+    atomic_init(&_head, &_stub);
+    _tail = &_stub;
+    atomic_init(&_count, 0);
+  }
+  return self;
+}
+
+- (instancetype)initWithPool:(_FBKVOWorkerPool *)pool
+{
+  self = [self initWithQueue:NULL];
+  if (nil != self) {
+    _pool = pool;
+  }
+  return self;
+}
+
+- (void)dealloc
+{
+  // release deliveries pending on deallocation
+  _FBKVOMailboxNode *node = _tail;
+  while (NULL != node) {
+    _FBKVOMailboxNode *next = atomic_load_explicit(&node->next, memory_order_acquire);
+    if (NULL != node->block) {
+      CFRelease(node->block);
+    }
+    if (node != &_stub) {
+      free(node);
+    }
+    node = next;
+  }
+}
+
+@end
+
+static dispatch_block_t mailbox_pop(_FBKVOMailbox *mailbox)
+{
+  _FBKVOMailboxNode *tail = mailbox->_tail;
+  _FBKVOMailboxNode *next;
+
+  // a counted delivery may not be linked by its producer yet
+  while (NULL == (next = atomic_load_explicit(&tail->next, memory_order_acquire))) {
+    sched_yield();
+  }
+
+  mailbox->_tail = next;
+  dispatch_block_t block = (__bridge_transfer dispatch_block_t)next->block;
+  next->block = NULL;
+  if (tail != &mailbox->_stub) {
+    free(tail);
+  }
+  return block;
+}
+
+static void mailbox_drain(void *context);
+
+static void mailbox_drain_queued(void *context)
+{
+  // balances the retain of the scheduled drain
+  _FBKVOMailbox *mailbox = (__bridge_transfer _FBKVOMailbox *)context;
+  mailbox_drain((__bridge void *)mailbox);
+}
+
+static void mailbox_schedule(_FBKVOMailbox *mailbox)
+{
+  if (nil != mailbox->_pool) {
+    pool_submit(mailbox->_pool, mailbox);
+  } else {
+    // a pending drain keeps the mailbox alive
+    dispatch_async_f(mailbox->_queue, (__bridge_retained void *)mailbox, mailbox_drain_queued);
+  }
+}
+
+static void mailbox_drain(void *context)
+{
+  _FBKVOMailbox *mailbox = (__bridge _FBKVOMailbox *)context;
+  for (NSUInteger idx = 0; idx < FBKVOMailboxDrainBatch; idx++) {
+    @autoreleasepool {
+      mailbox_pop(mailbox)();
+    }
+    if (1 == atomic_fetch_sub_explicit(&mailbox->_count, 1, memory_order_acq_rel)) {
+      // empty; the next push schedules a drain
+      return;
+    }
+  }
+
+  // still pending, continue after other work on the queue
+  mailbox_schedule(mailbox);
+}
+
+static void mailbox_push(_FBKVOMailbox *mailbox, dispatch_block_t block)
+{
+  _FBKVOMailboxNode *node = malloc(sizeof(_FBKVOMailboxNode));
+  atomic_init(&node->next, NULL);
+  dispatch_block_t copiedBlock = [block copy];
+  node->block = (__bridge_retained void *)copiedBlock;
+
+  _FBKVOMailboxNode *previous = atomic_exchange_explicit(&mailbox->_head, node, memory_order_acq_rel);
+  atomic_store_explicit(&previous->next, node, memory_order_release);
+
+  if (0 == atomic_fetch_add_explicit(&mailbox->_count, 1, memory_order_acq_rel)) {
+    mailbox_schedule(mailbox);
+  }
+}
+
+/**
+ @abstract Runs block on the notifying thread if the actor is idle, otherwise queues it behind the running block.
+ @discussion The pending count doubles as the run flag, so an uncontended block runs without allocating. Blocks queued while running are drained on the worker pool, rather than on the notifying thread.
+ */
+static void actor_run(_FBKVOMailbox *actor, dispatch_block_t block)
+{
+  // claim the idle actor, otherwise queue like any producer
+  intptr_t idle = 0;
+  if (!atomic_compare_exchange_strong_explicit(&actor->_count, &idle, 1, memory_order_acq_rel, memory_order_acquire)) {
+    mailbox_push(actor, block);
+    return;
+  }
+
+  block();
+
+  if (1 != atomic_fetch_sub_explicit(&actor->_count, 1, memory_order_acq_rel)) {
+    // blocks were queued while running, hand the run to the pool
+    mailbox_schedule(actor);
+  }
+}
+
+static BOOL mailbox_is_empty(_FBKVOMailbox *mailbox)
+{
+  return nil == mailbox || 0 == atomic_load_explicit(&mailbox->_count, memory_order_acquire);
+}
+
+static void begin_batches(_FBKVOThreadState *state)
+{
+  state->_batchDepth++;
+}
+
+static void end_batches(_FBKVOThreadState *state)
+{
+  if (0 != --state->_batchDepth || 0 == state->_batches.count) {
+    return;
+  }
+
+  // take batches first, executors may deliver and batch reentrantly
+  NSArray<_FBKVOExecutorBatch *> *batches = [state->_batches copy];
+  [state->_batches removeAllObjects];
+
+  for (_FBKVOExecutorBatch *batch in batches) {
+    NSUInteger count = batch->_blocks.count;
+    __unsafe_unretained dispatch_block_t *blocks = (__unsafe_unretained dispatch_block_t *)malloc(count * sizeof(dispatch_block_t));
+    [batch->_blocks getObjects:blocks range:NSMakeRange(0, count)];
+    [batch->_executor enqueueBlocks:blocks count:count observation:batch->_info];
+    free(blocks);
+  }
+}
+
+static void enqueue_delivery(id<FBKVOExecutor> executor, _FBKVOInfo *info, dispatch_block_t block)
+{
+  _FBKVOThreadState *state = current_thread_state();
+  if (0 == state->_batchDepth) {
+    __unsafe_unretained dispatch_block_t blocks[1] = { block };
+    [executor enqueueBlocks:blocks count:1 observation:info];
+    return;
+  }
+
+  // extend the batch of consecutive deliveries of the same observation
+  _FBKVOExecutorBatch *batch = state->_batches.lastObject;
+  if (nil == batch || batch->_info != info || batch->_executor != executor) {
+    batch = [[_FBKVOExecutorBatch alloc] init];
+    batch->_executor = executor;
+    batch->_info = info;
+    batch->_blocks = [NSMutableArray array];
+    [state->_batches addObject:batch];
+  }
+  [batch->_blocks addObject:[block copy]];
+}
+
+/**
+ @abstract Claims one of the remaining deliveries of a limited info.
+ @return The remaining deliveries before the claim, 0 if exhausted, 1 for the last delivery.
+ */
+static NSUInteger claim_delivery(_FBKVOInfo *info)
+{
+  NSUInteger remaining = atomic_load_explicit(&info->_remaining, memory_order_acquire);
+  while (0 != remaining && !atomic_compare_exchange_weak_explicit(&info->_remaining, &remaining, remaining - 1, memory_order_acq_rel, memory_order_acquire)) {
+  }
+  return remaining;
+}
+
+static void end_delivery(FBKVOController *controller)
+{
+  if (1 != atomic_fetch_sub_explicit(&controller->_inflight, 1, memory_order_acq_rel)) {
+    return;
+  }
+
+  // last delivery in flight, wake flushes
+  NSArray<dispatch_block_t> *completions = nil;
+  pthread_mutex_lock(&controller->_flushMutex);
+  if (0 == atomic_load_explicit(&controller->_inflight, memory_order_acquire) && 0 != controller->_flushCompletions.count) {
+    completions = controller->_flushCompletions;
+    controller->_flushCompletions = nil;
+  }
+  pthread_cond_broadcast(&controller->_flushCondition);
+  pthread_mutex_unlock(&controller->_flushMutex);
+
+  for (dispatch_block_t completion in completions) {
+    completion();
+  }
+}
+
+static dispatch_block_t counted_block(FBKVOController *controller, dispatch_block_t delivery)
+{
+  // count in flight until run, for flushes
+  atomic_fetch_add_explicit(&controller->_inflight, 1, memory_order_acq_rel);
+  return ^{
+    delivery();
+    end_delivery(controller);
+  };
+}
+
+static void deliver_block(FBKVOController *controller, _FBKVOInfo *info, _FBKVOMailbox *actor, dispatch_queue_t queue, dispatch_block_t delivery)
+{
+  dispatch_block_t block = counted_block(controller, delivery);
+
+  if (nil != actor) {
+    actor_run(actor, block);
+    return;
+  }
+
+  id<FBKVOExecutor> executor = info->_executor;
+  if (nil != executor) {
+    enqueue_delivery(executor, info, block);
+    return;
+  }
+
+  _FBKVOMailbox *mailbox = info->_mailbox;
+  if (nil != mailbox) {
+    mailbox_push(mailbox, block);
+  } else {
+    dispatch_async(queue, block);
+  }
+}
+
+#pragma mark _FBKVOWorkerPool -
+
+// capacity of a worker deque, a power of two; submissions past capacity are injected
+#define FBKVO_DEQUE_CAPACITY 1024
+
+/**
+ @abstract A Chase-Lev work-stealing deque of retained mailboxes.
+ @discussion Only the owning worker pushes and takes, at the bottom. Other workers steal from the top.
+ */
+typedef struct {
+  _Atomic(int64_t) top;
+  _Atomic(int64_t) bottom;
+  _Atomic(void *) buffer[FBKVO_DEQUE_CAPACITY];
+} _FBKVODeque;
+
+static BOOL deque_push(_FBKVODeque *deque, void *item)
+{
+  int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+  int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+  if (bottom - top >= FBKVO_DEQUE_CAPACITY) {
+    return NO;
+  }
+  atomic_store_explicit(&deque->buffer[bottom & (FBKVO_DEQUE_CAPACITY - 1)], item, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+  return YES;
+}
+
+static void *deque_take(_FBKVODeque *deque)
+{
+  int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+  atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  int64_t top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+  if (top > bottom) {
+    // empty
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return NULL;
+  }
+
+  void *item = atomic_load_explicit(&deque->buffer[bottom & (FBKVO_DEQUE_CAPACITY - 1)], memory_order_relaxed);
+  if (top == bottom) {
+    // last item, race thieves for it
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed)) {
+      item = NULL;
+    }
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+  }
+  return item;
+}
+
+static void *deque_steal(_FBKVODeque *deque)
+{
+  int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+  if (top >= bottom) {
+    return NULL;
+  }
+
+  void *item = atomic_load_explicit(&deque->buffer[top & (FBKVO_DEQUE_CAPACITY - 1)], memory_order_relaxed);
+  if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed)) {
+    // lost to the owner or another thief
+    return NULL;
+  }
+  return item;
+}
+
+/**
+ @abstract A pool of worker threads draining mailboxes.
+ @discussion Each worker owns a deque. Mailboxes scheduled from a worker are pushed on its deque, others are injected through a shared queue. Idle workers take injected mailboxes, then steal from other workers, before sleeping.
+ */
+@interface _FBKVOWorkerPool : NSObject
+@end
+
+@implementation _FBKVOWorkerPool
+{
+@public
+  NSUInteger _count;
+  _FBKVODeque *_deques;
+  _Atomic(NSUInteger) _started;
+  _Atomic(NSUInteger) _idle;
+  // guards injected, stopped and sleeping workers
+  pthread_mutex_t _mutex;
+  pthread_cond_t _condition;
+  NSMutableArray<_FBKVOMailbox *> *_injected;
+  BOOL _stopped;
+}
+
+static void *pool_worker(void *context);
+
+- (instancetype)initWithThreadCount:(NSUInteger)count
+{
+  self = [super init];
+  if (nil != self) {
+    _count = MAX(count, 1u);
+    _deques = calloc(_count, sizeof(_FBKVODeque));
+    _injected = [NSMutableArray array];
+    pthread_mutex_init(&_mutex, NULL);
+    pthread_cond_init(&_condition, NULL);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (NSUInteger idx = 0; idx < _count; idx++) {
+      // workers retain the pool until stopped
+      pthread_t thread;
+      pthread_create(&thread, &attr, pool_worker, (__bridge_retained void *)self);
+    }
+    pthread_attr_destroy(&attr);
+  }
+  return self;
+}
+
+- (void)dealloc
+{
+  pthread_cond_destroy(&_condition);
+  pthread_mutex_destroy(&_mutex);
+  free(_deques);
+}
+
+- (void)stop
+{
+  pthread_mutex_lock(&_mutex);
+  _stopped = YES;
+  pthread_cond_broadcast(&_condition);
+  pthread_mutex_unlock(&_mutex);
+}
+
+@end
+
+static void pool_submit(_FBKVOWorkerPool *pool, _FBKVOMailbox *mailbox)
+{
+  // push locally on a worker of the pool, leaving it to idle workers to steal
+  _FBKVOThreadState *state = current_thread_state();
+  if (state->_pool == pool) {
+    void *item = (__bridge_retained void *)mailbox;
+    if (deque_push(&pool->_deques[state->_workerIndex], item)) {
+      if (0 != atomic_load_explicit(&pool->_idle, memory_order_acquire)) {
+        pthread_mutex_lock(&pool->_mutex);
+        pthread_cond_signal(&pool->_condition);
+        pthread_mutex_unlock(&pool->_mutex);
+      }
+      return;
+    }
+    CFRelease(item);
+  }
+
+  pthread_mutex_lock(&pool->_mutex);
+  [pool->_injected addObject:mailbox];
+  pthread_cond_signal(&pool->_condition);
+  pthread_mutex_unlock(&pool->_mutex);
+}
+
+static _FBKVOMailbox *pool_next(_FBKVOWorkerPool *pool, NSUInteger index)
+{
+  void *item = deque_take(&pool->_deques[index]);
+  if (NULL != item) {
+    return (__bridge_transfer _FBKVOMailbox *)item;
+  }
+
+  _FBKVOMailbox *mailbox = nil;
+  pthread_mutex_lock(&pool->_mutex);
+  if (0 != pool->_injected.count) {
+    mailbox = pool->_injected.firstObject;
+    [pool->_injected removeObjectAtIndex:0];
+  }
+  pthread_mutex_unlock(&pool->_mutex);
+  if (nil != mailbox) {
+    return mailbox;
+  }
+
+  for (NSUInteger offset = 1; offset < pool->_count; offset++) {
+    item = deque_steal(&pool->_deques[(index + offset) % pool->_count]);
+    if (NULL != item) {
+      return (__bridge_transfer _FBKVOMailbox *)item;
+    }
+  }
+  return nil;
+}
+
+static void *pool_worker(void *context)
+{
+  _FBKVOWorkerPool *pool = (__bridge_transfer _FBKVOWorkerPool *)context;
+  NSUInteger index = atomic_fetch_add_explicit(&pool->_started, 1, memory_order_relaxed);
+  pthread_setname_np("com.facebook.FBKVOController.worker");
+
+  _FBKVOThreadState *state = current_thread_state();
+  state->_pool = pool;
+  state->_workerIndex = index;
+
+  for (;;) {
+    @autoreleasepool {
+      _FBKVOMailbox *mailbox = pool_next(pool, index);
+      if (nil != mailbox) {
+        mailbox_drain((__bridge void *)mailbox);
+        continue;
+      }
+
+      pthread_mutex_lock(&pool->_mutex);
+      if (0 == pool->_injected.count) {
+        if (pool->_stopped) {
+          pthread_mutex_unlock(&pool->_mutex);
+          break;
+        }
+        atomic_fetch_add_explicit(&pool->_idle, 1, memory_order_acq_rel);
+        pthread_cond_wait(&pool->_condition, &pool->_mutex);
+        atomic_fetch_sub_explicit(&pool->_idle, 1, memory_order_acq_rel);
+      }
+      pthread_mutex_unlock(&pool->_mutex);
+    }
+  }
+
+  state->_pool = nil;
+  return NULL;
+}
+
+#pragma mark FBKVODispatchExecutor -
+
+@implementation FBKVODispatchExecutor
+{
+  _FBKVOMailbox *_mailbox;
+}
+
++ (instancetype)mainQueueExecutor
+{
+  static FBKVODispatchExecutor *_executor = nil;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    _executor = [[FBKVODispatchExecutor alloc] initWithQueue:dispatch_get_main_queue()];
+  });
+  return _executor;
+}
+
+- (instancetype)initWithQueue:(dispatch_queue_t)queue
+{
+  NSAssert(NULL != queue, @"missing required parameter queue");
+  self = [super init];
+  if (nil != self) {
+    _mailbox = [[_FBKVOSharedController sharedController] mailboxForQueue:queue];
+  }
+  return self;
+}
+
+- (void)enqueueBlocks:(const dispatch_block_t _Nonnull [_Nonnull])blocks count:(NSUInteger)count observation:(id)observation
+{
+  for (NSUInteger idx = 0; idx < count; idx++) {
+    mailbox_push(_mailbox, blocks[idx]);
+  }
+}
+
+@end
+
+#pragma mark FBKVOCurrentThreadExecutor -
+
+@implementation FBKVOCurrentThreadExecutor
+
++ (instancetype)sharedExecutor
+{
+  static FBKVOCurrentThreadExecutor *_executor = nil;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    _executor = [[FBKVOCurrentThreadExecutor alloc] init];
+  });
+  return _executor;
+}
+
+- (void)enqueueBlocks:(const dispatch_block_t _Nonnull [_Nonnull])blocks count:(NSUInteger)count observation:(id)observation
+{
+  for (NSUInteger idx = 0; idx < count; idx++) {
+    blocks[idx]();
+  }
+}
+
+@end
+
+#pragma mark FBKVOWorkStealingExecutor -
+
+@implementation FBKVOWorkStealingExecutor
+{
+@public
+  _FBKVOWorkerPool *_pool;
+  // mailbox per observation, serializing its deliveries, guarded by mutex
+  NSMapTable<id, _FBKVOMailbox *> *_strands;
+  pthread_mutex_t _mutex;
+}
+
++ (instancetype)sharedExecutor
+{
+  static FBKVOWorkStealingExecutor *_executor = nil;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    _executor = [[FBKVOWorkStealingExecutor alloc] initWithThreadCount:[NSProcessInfo processInfo].activeProcessorCount];
+  });
+  return _executor;
+}
+
+- (instancetype)initWithThreadCount:(NSUInteger)threadCount
+{
+  self = [super init];
+  if (nil != self) {
+    _pool = [[_FBKVOWorkerPool alloc] initWithThreadCount:threadCount];
+    _strands = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsWeakMemory|NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+    pthread_mutex_init(&_mutex, NULL);
+  }
+  return self;
+}
+
+- (void)dealloc
+{
+  [_pool stop];
+  pthread_mutex_destroy(&_mutex);
+}
+
+- (void)enqueueBlocks:(const dispatch_block_t _Nonnull [_Nonnull])blocks count:(NSUInteger)count observation:(id)observation
+{
+  pthread_mutex_lock(&_mutex);
+  _FBKVOMailbox *strand = [_strands objectForKey:observation];
+  if (nil == strand) {
+    strand = [[_FBKVOMailbox alloc] initWithPool:_pool];
+    [_strands setObject:strand forKey:observation];
+  }
+  pthread_mutex_unlock(&_mutex);
+
+  // the strand runs on one worker at a time, in order
+  for (NSUInteger idx = 0; idx < count; idx++) {
+    mailbox_push(strand, blocks[idx]);
+  }
+}
+
+@end
+
+static _FBKVOWorkerPool *shared_worker_pool()
+{
+  return [FBKVOWorkStealingExecutor sharedExecutor]->_pool;
+}
+
+#pragma mark FBKVOChange -
+
+@implementation FBKVOChange
+
+static id _Nullable change_value(id _Nullable value)
+{
+  return [NSNull null] == value ? nil : value;
+}
+
+- (instancetype)initWithObject:(id)object change:(nullable NSDictionary<NSString *, id> *)change
+{
+  self = [super init];
+  if (nil != self) {
+    _object = object;
+    _kind = [change[NSKeyValueChangeKindKey] unsignedIntegerValue];
+    _oldValue = change_value(change[NSKeyValueChangeOldKey]);
+    _newValue = change_value(change[NSKeyValueChangeNewKey]);
+    _indexes = change[NSKeyValueChangeIndexesKey];
+    _timestamp = FBKVOTimestampNow();
+  }
+  return self;
+}
+
+- (NSString *)debugDescription
+{
+  return [NSString stringWithFormat:@"<%@:%p kind:%lu old:%@ new:%@>", NSStringFromClass([self class]), self, (unsigned long)_kind, _oldValue, _newValue];
+}
+
+@end
+
+#pragma mark FBKVOStream -
+
+@interface FBKVOStream ()
+- (instancetype)initWithCapacity:(NSUInteger)capacity controller:(FBKVOController *)controller object:(id)object keyPath:(NSString *)keyPath;
+@end
+
+@implementation FBKVOStream
+{
+@public
+  NSUInteger _mask;
+  // retained changes, written by the producer between tail and head + capacity
+  void **_slots;
+  // next slot to consume, written by the consumer only
+  _Atomic(uint64_t) _head;
+  // next slot to produce, written by the producer only
+  _Atomic(uint64_t) _tail;
+  _Atomic(uint64_t) _enqueuedCount;
+  _Atomic(uint64_t) _droppedCount;
+  _Atomic(bool) _cancelled;
+  // set while the consumer or a producer sleeps on its condition
+  _Atomic(bool) _consumerWaiting;
+  _Atomic(bool) _producerWaiting;
+  // serializes producers, and guards sleeping
+  pthread_mutex_t _mutex;
+  pthread_cond_t _notEmpty;
+  pthread_cond_t _notFull;
+  __weak FBKVOController *_controller;
+  __weak id _object;
+  NSString *_keyPath;
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity controller:(FBKVOController *)controller object:(id)object keyPath:(NSString *)keyPath
+{
+  self = [super init];
+  if (nil != self) {
+    // round up to a power of two, so that indexes wrap with a mask
+    NSUInteger roundedCapacity = 1;
+    while (roundedCapacity < capacity) {
+      roundedCapacity <<= 1;
+    }
+    _capacity = roundedCapacity;
+    _mask = roundedCapacity - 1;
+    _slots = calloc(roundedCapacity, sizeof(void *));
+    _controller = controller;
+    _object = object;
+    _keyPath = [keyPath copy];
+    pthread_mutex_init(&_mutex, NULL);
+    pthread_cond_init(&_notEmpty, NULL);
+    pthread_cond_init(&_notFull, NULL);
+  }
+  return self;
+}
+
+- (void)dealloc
+{
+  // release changes never taken
+  uint64_t tail = atomic_load(&_tail);
+  for (uint64_t idx = atomic_load(&_head); idx < tail; idx++) {
+    CFRelease(_slots[idx & _mask]);
+  }
+  free(_slots);
+  pthread_cond_destroy(&_notFull);
+  pthread_cond_destroy(&_notEmpty);
+  pthread_mutex_destroy(&_mutex);
+}
+
+- (uint64_t)enqueuedCount
+{
+  return atomic_load_explicit(&_enqueuedCount, memory_order_relaxed);
+}
+
+- (uint64_t)droppedCount
+{
+  return atomic_load_explicit(&_droppedCount, memory_order_relaxed);
+}
+
+- (BOOL)isCancelled
+{
+  return atomic_load(&_cancelled);
+}
+
+- (nullable FBKVOChange *)tryNext
+{
+  uint64_t head = atomic_load_explicit(&_head, memory_order_relaxed);
+  if (head == atomic_load_explicit(&_tail, memory_order_acquire)) {
+    return nil;
+  }
+
+  FBKVOChange *change = (__bridge_transfer FBKVOChange *)_slots[head & _mask];
+  atomic_store_explicit(&_head, head + 1, memory_order_seq_cst);
+  [self wakeProducer];
+  return change;
+}
+
+- (nullable FBKVOChange *)next
+{
+  for (;;) {
+    FBKVOChange *change = [self tryNext];
+    if (nil != change || atomic_load(&_cancelled)) {
+      return change ?: [self tryNext];
+    }
+
+    // announce waiting before re-checking, so that a racing producer wakes us
+    pthread_mutex_lock(&_mutex);
+    atomic_store(&_consumerWaiting, true);
+    while (atomic_load(&_head) == atomic_load(&_tail) && !atomic_load(&_cancelled)) {
+      pthread_cond_wait(&_notEmpty, &_mutex);
+    }
+    atomic_store(&_consumerWaiting, false);
+    pthread_mutex_unlock(&_mutex);
+  }
+}
+
+- (NSUInteger)drainInto:(NSMutableArray<FBKVOChange *> *)changes
+{
+  uint64_t head = atomic_load_explicit(&_head, memory_order_relaxed);
+  uint64_t tail = atomic_load_explicit(&_tail, memory_order_acquire);
+  for (uint64_t idx = head; idx < tail; idx++) {
+    [changes addObject:(__bridge_transfer FBKVOChange *)_slots[idx & _mask]];
+  }
+
+  // release all slots at once
+  if (head != tail) {
+    atomic_store_explicit(&_head, tail, memory_order_seq_cst);
+    [self wakeProducer];
+  }
+  return (NSUInteger)(tail - head);
+}
+
+- (void)cancel
+{
+  if (atomic_exchange(&_cancelled, true)) {
+    return;
+  }
+
+  FBKVOController *controller = _controller;
+  id object = _object;
+  if (nil != controller && nil != object) {
+    [controller unobserve:object keyPath:_keyPath];
+  }
+
+  pthread_mutex_lock(&_mutex);
+  pthread_cond_broadcast(&_notEmpty);
+  pthread_cond_broadcast(&_notFull);
+  pthread_mutex_unlock(&_mutex);
+}
+
+- (void)wakeProducer
+{
+  if (atomic_load(&_producerWaiting)) {
+    pthread_mutex_lock(&_mutex);
+    pthread_cond_signal(&_notFull);
+    pthread_mutex_unlock(&_mutex);
+  }
+}
+
+- (NSString *)debugDescription
+{
+  return [NSString stringWithFormat:@"<%@:%p keyPath:%@ capacity:%lu enqueued:%llu dropped:%llu>", NSStringFromClass([self class]), self, _keyPath, (unsigned long)_capacity, self.enqueuedCount, self.droppedCount];
+}
+
+@end
+
+static void stream_push(FBKVOStream *stream, id object, NSDictionary<NSString *, id> *_Nullable change)
+{
+  if (atomic_load_explicit(&stream->_cancelled, memory_order_relaxed)) {
+    return;
+  }
+
+  FBKVOChange *record = [[FBKVOChange alloc] initWithObject:object change:change];
+
+  // changing threads are serialized, making the ring single-producer
+  pthread_mutex_lock(&stream->_mutex);
+  uint64_t tail = atomic_load_explicit(&stream->_tail, memory_order_relaxed);
+  while (tail - atomic_load(&stream->_head) >= stream->_capacity) {
+    if (FBKVOStreamOverflowPolicyBlock != stream.overflowPolicy || atomic_load(&stream->_cancelled)) {
+      pthread_mutex_unlock(&stream->_mutex);
+      atomic_fetch_add_explicit(&stream->_droppedCount, 1, memory_order_relaxed);
+      return;
+    }
+    atomic_store(&stream->_producerWaiting, true);
+    if (tail - atomic_load(&stream->_head) >= stream->_capacity) {
+      pthread_cond_wait(&stream->_notFull, &stream->_mutex);
+    }
+    atomic_store(&stream->_producerWaiting, false);
+  }
+
+  stream->_slots[tail & stream->_mask] = (__bridge_retained void *)record;
+  atomic_store_explicit(&stream->_tail, tail + 1, memory_order_seq_cst);
+  atomic_fetch_add_explicit(&stream->_enqueuedCount, 1, memory_order_relaxed);
+
+  if (atomic_load(&stream->_consumerWaiting)) {
+    pthread_cond_signal(&stream->_notEmpty);
+  }
+  pthread_mutex_unlock(&stream->_mutex);
+}
+
+#pragma mark Observable Properties -
+
+#define FBKVO_OBSERVABLE_STRIPES 16
+
+static pthread_mutex_t _FBKVOObservableMutexes[FBKVO_OBSERVABLE_STRIPES] = {
+  PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+  PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+  PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+  PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+};
+
+static pthread_mutex_t *observable_mutex(FBKVOObservableSubscribers *subscribers)
+{
+  return &_FBKVOObservableMutexes[((uintptr_t)subscribers >> 4) % FBKVO_OBSERVABLE_STRIPES];
+}
+
+/**
+ @abstract Returns the subscribers of an observable property of object, NULL if not observable.
+ */
+static FBKVOObservableSubscribers *_Nullable observable_subscribers(id object, NSString *keyPath)
+{
+  if (NSNotFound != [keyPath rangeOfString:@"."].location) {
+    return NULL;
+  }
+  SEL selector = NSSelectorFromString([@"fbkvo_subscribers_" stringByAppendingString:keyPath]);
+  if (![object respondsToSelector:selector]) {
+    return NULL;
+  }
+  IMP imp = [object methodForSelector:selector];
+  return ((FBKVOObservableSubscribers *(*)(id, SEL))imp)(object, selector);
+}
+
+static NSArray<_FBKVOInfo *> *_Nullable observable_snapshot(FBKVOObservableSubscribers *subscribers)
+{
+  // take out a strong reference under lock, as updates release the previous snapshot
+  pthread_mutex_t *mutex = observable_mutex(subscribers);
+  pthread_mutex_lock(mutex);
+  NSArray<_FBKVOInfo *> *snapshot = (__bridge NSArray *)subscribers->_snapshot;
+  pthread_mutex_unlock(mutex);
+  return snapshot;
+}
+
+static void observable_update(FBKVOObservableSubscribers *subscribers, _FBKVOInfo *info, BOOL subscribe)
+{
+  pthread_mutex_t *mutex = observable_mutex(subscribers);
+  pthread_mutex_lock(mutex);
+  void *previous = subscribers->_snapshot;
+  NSMutableArray<_FBKVOInfo *> *updated = NULL != previous ? [(__bridge NSArray *)previous mutableCopy] : [NSMutableArray array];
+  if (subscribe) {
+    [updated addObject:info];
+  } else {
+    [updated removeObjectIdenticalTo:info];
+  }
+  void *snapshot = 0 != updated.count ? (void *)CFBridgingRetain([updated copy]) : NULL;
+  __atomic_store_n(&subscribers->_snapshot, snapshot, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(mutex);
+
+  if (NULL != previous) {
+    CFRelease(previous);
+  }
+}
+
+static NSDictionary<NSString *, id> *observable_change(NSKeyValueObservingOptions options, id _Nullable oldValue, id _Nullable newValue)
+{
+  NSMutableDictionary<NSString *, id> *change = [NSMutableDictionary dictionaryWithObject:@(NSKeyValueChangeSetting) forKey:NSKeyValueChangeKindKey];
+  if (0 != (options & NSKeyValueObservingOptionOld)) {
+    change[NSKeyValueChangeOldKey] = oldValue ?: [NSNull null];
+  }
+  if (0 != (options & NSKeyValueObservingOptionNew)) {
+    change[NSKeyValueChangeNewKey] = newValue ?: [NSNull null];
+  }
+  return change;
+}
+
+void FBKVOObservableDidChange(FBKVOObservableSubscribers *subscribers, id object, NSString *key, id _Nullable oldValue, id _Nullable newValue)
+{
+  NSArray<_FBKVOInfo *> *snapshot = observable_snapshot(subscribers);
+  if (0 == snapshot.count) {
+    return;
+  }
+
+  // notify as Foundation would, through the shared controller
+  _FBKVOSharedController *sharedController = [_FBKVOSharedController sharedController];
+  for (_FBKVOInfo *info in snapshot) {
+    NSDictionary<NSString *, id> *change = observable_change(info->_options, oldValue, newValue);
+    [sharedController observeValueForKeyPath:key ofObject:object change:change context:(__bridge void *)info];
+  }
+}
+
+#pragma mark _FBKVOSharedController -
+
+static FBKVOChangeStamp thread_change_stamp(_FBKVOThreadState *state, id object, NSString *keyPath, _FBKVOInfo *info)
+{
+  // Foundation notifies every observation of a change in turn on the changing thread,
+  // so a change is new once the object key path differs, or an info is notified again
+  if (state->_stampedObject != object || ![state->_stampedKeyPath isEqualToString:keyPath] || [state->_stampedInfos containsObject:info]) {
+    state->_stampedObject = object;
+    state->_stampedKeyPath = keyPath;
+    [state->_stampedInfos removeAllObjects];
+    state->_stamp.sequence = atomic_fetch_add_explicit(&_FBKVOChangeSequence, 1, memory_order_relaxed) + 1;
+    state->_stamp.timestamp = FBKVOTimestampNow();
+  }
+  [state->_stampedInfos addObject:info];
+  return state->_stamp;
+}
+
+static NSArray<NSString *> *cycle_key_paths(NSArray<_FBKVOInfo *> *stack, _FBKVOInfo *info)
+{
+  NSUInteger start = [stack indexOfObjectIdenticalTo:info];
+  NSMutableArray<NSString *> *keyPaths = [NSMutableArray arrayWithCapacity:stack.count - start + 1];
+  for (NSUInteger idx = start; idx < stack.count; idx++) {
+    [keyPaths addObject:stack[idx]->_keyPath];
+  }
+  [keyPaths addObject:info->_keyPath];
+  return keyPaths;
+}
+
+@implementation _FBKVOSharedController
+{
+  NSHashTable<_FBKVOInfo *> *_infos;
+  // priority lanes per target queue, guarded by mutex; lanes live while observations use them
+  NSMapTable<dispatch_queue_t, NSMapTable<NSNumber *, dispatch_queue_t> *> *_lanes;
+  // delivery mailboxes per queue, guarded by mutex; mailboxes live while infos or pending drains use them
+  NSMapTable<dispatch_queue_t, _FBKVOMailbox *> *_mailboxes;
+  pthread_mutex_t _mutex;
+}
+
++ (instancetype)sharedController
+{
+  static _FBKVOSharedController *_controller = nil;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    _controller = [[_FBKVOSharedController alloc] init];
+  });
+  return _controller;
+}
+
+- (instancetype)init
+{
+  self = [super init];
+  if (nil != self) {
+    NSHashTable *infos = [NSHashTable alloc];
+#ifdef __IPHONE_OS_VERSION_MIN_REQUIRED
+    _infos = [infos initWithOptions:NSPointerFunctionsWeakMemory|NSPointerFunctionsObjectPointerPersonality capacity:0];
+#elif defined(__MAC_OS_X_VERSION_MIN_REQUIRED)
+    if ([NSHashTable respondsToSelector:@selector(weakObjectsHashTable)]) {
+      _infos = [infos initWithOptions:NSPointerFunctionsWeakMemory|NSPointerFunctionsObjectPointerPersonality capacity:0];
+    } else {
+      // silence deprecated warnings
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+      _infos = [infos initWithOptions:NSPointerFunctionsZeroingWeakMemory|NSPointerFunctionsObjectPointerPersonality capacity:0];
+#pragma clang diagnostic pop
+    }
+
+#endif
+    _lanes = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsWeakMemory|NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+    _mailboxes = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsWeakMemory|NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsWeakMemory];
+    pthread_mutex_init(&_mutex, NULL);
+    _maximumDepth = NSUIntegerMax;
+  }
+  return self;
+}
+
+- (void)dealloc
+{
+  pthread_mutex_destroy(&_mutex);
+}
+
+- (NSString *)debugDescription
+{
+  NSMutableString *s = [NSMutableString stringWithFormat:@"<%@:%p", NSStringFromClass([self class]), self];
+
+  // lock
+  pthread_mutex_lock(&_mutex);
+
+  NSMutableArray *infoDescriptions = [NSMutableArray arrayWithCapacity:_infos.count];
+  for (_FBKVOInfo *info in _infos) {
+    [infoDescriptions addObject:info.debugDescription];
+  }
+
+  [s appendFormat:@" contexts:%@", infoDescriptions];
+
+  // unlock
+  pthread_mutex_unlock(&_mutex);
+
+  [s appendString:@">"];
+  return s;
+}
+
+- (void)observe:(id)object info:(nullable _FBKVOInfo *)info
+{
+  if (nil == info) {
+    return;
+  }
+
+  // resolve the mailbox of asynchronous deliveries once, and tag the queue for inline delivery
+  if (NULL != info->_queue && nil == info->_mailbox) {
+    info->_mailbox = [self mailboxForQueue:info->_lane ?: info->_queue];
+    tag_queue(info->_queue);
   }
 
   // register info
   pthread_mutex_lock(&_mutex);
-  [_infos addObject:info];
+  [_infos addObject:info];
+  pthread_mutex_unlock(&_mutex);
+
+  if (info->_async) {
+    dispatch_async(registration_lane(object), ^{
+      [self attach:object info:info];
+    });
+  } else {
+    [self attach:object info:info];
+  }
+}
+
+- (void)attach:(id)object info:(_FBKVOInfo *)info
+{
+  // add observer, subscribing to observable properties in place of Foundation
+  FBKVOObservableSubscribers *subscribers = observable_subscribers(object, info->_keyPath);
+  if (NULL != subscribers) {
+    info->_subscribers = subscribers;
+    observable_update(subscribers, info, YES);
+    if (0 != (info->_options & NSKeyValueObservingOptionInitial)) {
+      NSDictionary<NSString *, id> *change = observable_change(info->_options & NSKeyValueObservingOptionNew, nil, [object valueForKey:info->_keyPath]);
+      [self observeValueForKeyPath:info->_keyPath ofObject:object change:change context:(void *)info];
+    }
+  } else {
+    [object addObserver:self forKeyPath:info->_keyPath options:info->_options context:(void *)info];
+  }
+
+  uint8_t state = _FBKVOInfoStateInitial;
+  if (!atomic_compare_exchange_strong(&info->_state, &state, _FBKVOInfoStateObserving)) {
+    // this could happen when `NSKeyValueObservingOptionInitial` is one of the NSKeyValueObservingOptions,
+    // and the observer is unregistered within the callback block.
+    // at this time the object has been registered as an observer (in Foundation KVO),
+    // so we can safely unobserve it.
+    [self stopObserving:object info:info];
+  }
+}
+
+- (void)stopObserving:(id)object info:(_FBKVOInfo *)info
+{
+  if (NULL != info->_subscribers) {
+    observable_update(info->_subscribers, info, NO);
+  } else {
+    [object removeObserver:self forKeyPath:info->_keyPath context:(void *)info];
+  }
+}
+
+- (void)detach:(id)object infos:(id<NSFastEnumeration>)infos
+{
+  // remove observer
+  for (_FBKVOInfo *info in infos) {
+    if (_FBKVOInfoStateObserving == atomic_exchange(&info->_state, _FBKVOInfoStateNotObserving)) {
+      [self stopObserving:object info:info];
+    }
+  }
+}
+
+- (void)detach:(id)object infos:(id<NSFastEnumeration>)infos async:(BOOL)async
+{
+  // never wait on the lane, as from dealloc on the main thread; a pending registration
+  // finds its info no longer initial, and removes the observer itself, see attach:info:
+  if (!async) {
+    [self detach:object infos:infos];
+    return;
+  }
+
+  // order removal after pending registration on the lane
+  dispatch_async(registration_lane(object), ^{
+    [self detach:object infos:infos];
+  });
+}
+
+- (void)unobserve:(id)object info:(nullable _FBKVOInfo *)info
+{
+  if (nil == info) {
+    return;
+  }
+
+  // unregister info
+  pthread_mutex_lock(&_mutex);
+  [_infos removeObject:info];
+  pthread_mutex_unlock(&_mutex);
+
+  [self detach:object infos:@[info] async:NO];
+}
+
+- (void)unobserve:(id)object infos:(nullable NSSet<_FBKVOInfo *> *)infos
+{
+  if (0 == infos.count) {
+    return;
+  }
+
+  // unregister info
+  pthread_mutex_lock(&_mutex);
+  for (_FBKVOInfo *info in infos) {
+    [_infos removeObject:info];
+  }
+  pthread_mutex_unlock(&_mutex);
+
+  [self detach:object infos:infos async:NO];
+}
+
+- (void)unobserveAsync:(id)object infos:(nullable NSSet<_FBKVOInfo *> *)infos
+{
+  if (0 == infos.count) {
+    return;
+  }
+
+  // unregister info, so notifications stop immediately
+  pthread_mutex_lock(&_mutex);
+  for (_FBKVOInfo *info in infos) {
+    [_infos removeObject:info];
+  }
+  pthread_mutex_unlock(&_mutex);
+
+  [self detach:object infos:infos async:YES];
+}
+
+- (void)observeValueForKeyPath:(nullable NSString *)keyPath
+                      ofObject:(nullable id)object
+                        change:(nullable NSDictionary<NSString *, id> *)change
+                       context:(nullable void *)context
+{
+  NSAssert(context, @"missing context keyPath:%@ object:%@ change:%@", keyPath, object, change);
+
+  _FBKVOInfo *info;
+
+  {
+    // lookup context in registered infos, taking out a strong reference only if it exists
+    pthread_mutex_lock(&_mutex);
+    info = [_infos member:(__bridge id)context];
+    pthread_mutex_unlock(&_mutex);
+  }
+
+  if (nil != info) {
+    _FBKVOThreadState *state = current_thread_state();
+
+    // stamp before buffering or deferral, so stamps reflect the order of changes, once per change
+    if (info->_stamped) {
+      change = stamp_change(change, thread_change_stamp(state, object, keyPath, info));
+    }
+
+    // defer notification until the current thread's transaction commits
+    if (nil != state->_transaction) {
+      [state->_transaction addInfo:info object:object keyPath:keyPath change:change];
+      return;
+    }
+
+    [self deliverInfo:info object:object keyPath:keyPath change:change state:state];
+  }
+}
+
+- (void)deliverInfo:(_FBKVOInfo *)info object:(nullable id)object keyPath:(nullable NSString *)keyPath change:(nullable NSDictionary<NSString *, id> *)change state:(_FBKVOThreadState *)state
+{
+  // defer rather than recurse past the maximum depth
+  if (state->_depth >= _maximumDepth) {
+    // report observers changing observed values they caused to change, once recursion is cut
+    void (^handler)(NSArray<NSString *> *) = self.cycleHandler;
+    if (NULL != handler && !state->_cycleReported && NSNotFound != [state->_stack indexOfObjectIdenticalTo:info]) {
+      state->_cycleReported = YES;
+      handler(cycle_key_paths(state->_stack, info));
+    }
+
+    _FBKVODeferredNotification *notification = [[_FBKVODeferredNotification alloc] init];
+    notification->_info = info;
+    notification->_object = object;
+    notification->_keyPath = keyPath;
+    notification->_change = change;
+    [state->_deferred addObject:notification];
+    return;
+  }
+
+  [self notifyInfo:info object:object keyPath:keyPath change:change state:state];
+
+  // the outermost notification delivers deferred notifications, bounding stack depth
+  if (0 == state->_depth) {
+    while (0 != state->_deferred.count) {
+      _FBKVODeferredNotification *notification = state->_deferred.firstObject;
+      [state->_deferred removeObjectAtIndex:0];
+      if ([self isObservingInfo:notification->_info]) {
+        [self notifyInfo:notification->_info object:notification->_object keyPath:notification->_keyPath change:notification->_change state:state];
+      }
+    }
+    state->_cycleReported = NO;
+  }
+}
+
+- (void)notifyInfo:(_FBKVOInfo *)info object:(nullable id)object keyPath:(nullable NSString *)keyPath change:(nullable NSDictionary<NSString *, id> *)change state:(_FBKVOThreadState *)state
+{
+  state->_depth++;
+  [state->_stack addObject:info];
+  [self notifyInfo:info object:object keyPath:keyPath change:change];
+  [state->_stack removeLastObject];
+  state->_depth--;
+}
+
+- (_FBKVOMailbox *)mailboxForQueue:(dispatch_queue_t)queue
+{
+  pthread_mutex_lock(&_mutex);
+  _FBKVOMailbox *mailbox = [_mailboxes objectForKey:queue];
+  if (nil == mailbox) {
+    mailbox = [[_FBKVOMailbox alloc] initWithQueue:queue];
+    [_mailboxes setObject:mailbox forKey:queue];
+  }
+  pthread_mutex_unlock(&_mutex);
+  return mailbox;
+}
+
+- (dispatch_queue_t)laneForQueue:(dispatch_queue_t)queue priority:(FBKVODeliveryPriority)priority
+{
+  pthread_mutex_lock(&_mutex);
+
+  // weakly keyed by queue, so a lane retaining its target does not keep the queue alive
+  NSMapTable<NSNumber *, dispatch_queue_t> *lanes = [_lanes objectForKey:queue];
+  if (nil == lanes) {
+    lanes = [NSMapTable strongToWeakObjectsMapTable];
+    [_lanes setObject:lanes forKey:queue];
+  }
+
+  // lanes are shared by all observations targeting the same queue at the same priority, and retained by their infos
+  dispatch_queue_t lane = [lanes objectForKey:@(priority)];
+  if (nil == lane) {
+    lane = make_lane(queue, priority);
+    [lanes setObject:lane forKey:@(priority)];
+  }
+
+  pthread_mutex_unlock(&_mutex);
+  return lane;
+}
+
+- (BOOL)isObservingInfo:(_FBKVOInfo *)info
+{
+  pthread_mutex_lock(&_mutex);
+  BOOL observing = (nil != [_infos member:info]);
+  pthread_mutex_unlock(&_mutex);
+  return observing;
+}
+
+- (void)notifyBufferedNotifications:(NSArray<_FBKVOBufferedNotification *> *)entries
+{
+  _FBKVOThreadState *state = current_thread_state();
+  begin_batches(state);
+
+  for (_FBKVOBufferedNotification *entry in entries) {
+    _FBKVOInfo *info = entry->_info;
+
+    // skip infos unobserved while buffered
+    if (![self isObservingInfo:info]) {
+      continue;
+    }
+
+    // cascades caused by buffered deliveries are bounded like any other
+    if (nil != entry->_priorChange) {
+      [self deliverInfo:info object:entry->_object keyPath:entry->_keyPath change:entry->_priorChange state:state];
+    }
+    for (NSDictionary<NSString *, id> *change in entry->_changes) {
+      [self deliverInfo:info object:entry->_object keyPath:entry->_keyPath change:change state:state];
+    }
+    if (entry->_collapsed) {
+      [self deliverInfo:info object:entry->_object keyPath:entry->_keyPath change:collapsed_change(info->_options, entry->_object, entry->_keyPath) state:state];
+    }
+  }
+
+  end_batches(state);
+}
+
+- (void)notifyInfo:(_FBKVOInfo *)info object:(nullable id)object keyPath:(nullable NSString *)keyPath change:(nullable NSDictionary<NSString *, id> *)change
+{
+  // take strong reference to controller
+  FBKVOController *controller = info->_controller;
+  if (nil != controller) {
+
+    // paused observations drop or retain notifications
+    uint8_t pauseState = MAX(atomic_load_explicit(&controller->_pauseState, memory_order_relaxed),
+                             atomic_load_explicit(&info->_pauseState, memory_order_relaxed));
+    if (_FBKVOPauseStateNone != pauseState) {
+      // retained notifications are delivered on resume before the pause state clears
+      _FBKVOThreadState *state = current_thread_state();
+      BOOL resuming = (controller == state->_resumingController && state->_resumingPredicate(info));
+      if (!resuming && [controller _withholdNotificationForInfo:info object:object keyPath:keyPath change:change]) {
+        return;
+      }
+    }
+
+    // limited observations claim a delivery, removing themselves on the last one
+    if (info->_limited) {
+      if ([change[NSKeyValueChangeNotificationIsPriorKey] boolValue]) {
+        if (0 == atomic_load_explicit(&info->_remaining, memory_order_acquire)) {
+          return;
+        }
+      } else {
+        NSUInteger remaining = claim_delivery(info);
+        if (0 == remaining) {
+          return;
+        }
+        if (1 == remaining) {
+          // remove before delivery, so the block may observe the key path again
+          [controller _unobserve:object info:info];
+        }
+      }
+    }
+
+    // deliver through the executor, through the controller's actor or synchronously without a queue, or when already on the queue with no earlier delivery pending
+    // the actor only serializes observations without a queue or executor, which keep delivering on their target
+    _FBKVOMailbox *actor = (NULL == info->_queue && nil == info->_executor && atomic_load_explicit(&controller->_serial, memory_order_acquire)) ? controller->_actor : nil;
+    BOOL async = (nil != actor || nil != info->_executor || (NULL != info->_queue && !(is_current_queue(info->_queue) && mailbox_is_empty(info->_mailbox))));
+    dispatch_queue_t queue = info->_lane ?: info->_queue;
+
+    // bindings copy values directly, independent of the observer
+    _FBKVOBinding *binding = info->_binding;
+    if (nil != binding) {
+      if (async) {
+        deliver_block(controller, info, actor, queue, ^{ [binding applyFromSource:object]; });
+      } else {
+        [binding applyFromSource:object];
+      }
+      return;
+    }
+
+    // streams buffer changes for their consumer
+    FBKVOStream *stream = info->_stream;
+    if (nil != stream) {
+      stream_push(stream, object, change);
+      return;
+    }
+
+    // sampled observations deliver on the next frame
+    _FBKVOFrameSampler *sampler = info->_sampler;
+    if (nil != sampler) {
+      [sampler sampleObject:object change:change controller:controller];
+      return;
+    }
+
+    // functions are called with their context, independent of the observer
+    FBKVONotificationFunction function = info->_function;
+    if (NULL != function) {
+      if (async) {
+        deliver_block(controller, info, actor, queue, ^{ function(info->_context, object, change); });
+      } else {
+        function(info->_context, object, change);
+      }
+      return;
+    }
+
+    // take strong reference to observer
+    id observer = controller.observer;
+    if (nil != observer) {
+
+      // dispatch custom block or action, fall back to default action
+      if (info->_block) {
+        if (async) {
+          deliver_block(controller, info, actor, queue, ^{ info->_block(observer, object, change); });
+        } else {
+          info->_block(observer, object, change);
+        }
+      } else if (info->_action) {
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Warc-performSelector-leaks"
+        if (async) {
+          deliver_block(controller, info, actor, queue, ^{ [observer performSelector:info->_action withObject:change withObject:object]; });
+        } else {
+          [observer performSelector:info->_action withObject:change withObject:object];
+        }
+#pragma clang diagnostic pop
+      } else {
+        if (async) {
+          deliver_block(controller, info, actor, queue, ^{ [observer observeValueForKeyPath:keyPath ofObject:object change:change context:info->_context]; });
+        } else {
+          [observer observeValueForKeyPath:keyPath ofObject:object change:change context:info->_context];
+        }
+      }
+    }
+  }
+}
+
+@end
+
+#pragma mark FBKVOAggregate -
+
+@interface FBKVOAggregate ()
+- (instancetype)initWithCount:(NSUInteger)count sum:(double)sum minimum:(nullable NSNumber *)minimum maximum:(nullable NSNumber *)maximum;
+@end
+
+@implementation FBKVOAggregate
+
+- (instancetype)initWithCount:(NSUInteger)count sum:(double)sum minimum:(nullable NSNumber *)minimum maximum:(nullable NSNumber *)maximum
+{
+  self = [super init];
+  if (nil != self) {
+    _count = count;
+    _sum = sum;
+    _minimum = minimum;
+    _maximum = maximum;
+  }
+  return self;
+}
+
+- (double)average
+{
+  return 0 == _count ? 0 : _sum / _count;
+}
+
+- (NSString *)debugDescription
+{
+  return [NSString stringWithFormat:@"<%@:%p count:%lu sum:%f minimum:%@ maximum:%@>", NSStringFromClass([self class]), self, (unsigned long)_count, _sum, _minimum, _maximum];
+}
+
+@end
+
+static NSArray *collection_elements(id _Nullable collection)
+{
+  if ([collection isKindOfClass:[NSArray class]]) {
+    return collection;
+  } else if ([collection isKindOfClass:[NSOrderedSet class]]) {
+    return [collection array];
+  } else if ([collection isKindOfClass:[NSSet class]]) {
+    return [collection allObjects];
+  }
+  return @[];
+}
+
+/**
+ @abstract Per element aggregate state.
+ */
+@interface _FBKVOAggregateEntry : NSObject
+@end
+
+@implementation _FBKVOAggregateEntry
+{
+@public
+  // number of times the element appears in the collection
+  NSUInteger _multiplicity;
+  BOOL _hasValue;
+  double _value;
+}
+@end
+
+/**
+ @abstract Incrementally maintains an aggregate over the elements of an observed collection.
+ @discussion Retained by the collection observation block, so that unobserving the collection also tears down element observation.
+ */
+@interface _FBKVOAggregateTracker : NSObject
+@end
+
+@implementation _FBKVOAggregateTracker
+{
+  __weak FBKVOController *_controller;
+  __weak id _object;
+  NSString *_elementKeyPath;
+  FBKVOAggregateBlock _block;
+  FBKVOController *_elementController;
+  // the queue of the collection observation, NULL delivering synchronously
+  dispatch_queue_t _queue;
+  NSMapTable<id, _FBKVOAggregateEntry *> *_entries;
+  NSUInteger _count;
+  NSUInteger _valueCount;
+  double _sum;
+  double _min;
+  double _max;
+  NSUInteger _minCount;
+  NSUInteger _maxCount;
+  BOOL _extremaValid;
+  NSUInteger _batchDepth;
+  pthread_mutex_t _mutex;
+}
+
+- (instancetype)initWithController:(FBKVOController *)controller object:(id)object elementKeyPath:(NSString *)elementKeyPath block:(FBKVOAggregateBlock)block
+{
+  self = [super init];
+  if (nil != self) {
+    _controller = controller;
+    _object = object;
+    _elementKeyPath = [elementKeyPath copy];
+    _block = [block copy];
+    _queue = controller.defaultQueue;
+    _elementController = [[FBKVOController alloc] initWithObserver:self retainObserved:YES];
+    // element values are applied synchronously, ahead of the collection notification
+    _elementController.defaultQueue = NULL;
+    _entries = [[NSMapTable alloc] initWithKeyOptions:NSPointerFunctionsStrongMemory|NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory|NSPointerFunctionsObjectPersonality capacity:0];
+    _extremaValid = YES;
+    pthread_mutex_init(&_mutex, NULL);
+  }
+  return self;
+}
+
+- (void)dealloc
+{
+  [_elementController unobserveAll];
+  pthread_mutex_destroy(&_mutex);
+}
+
+#pragma mark Accumulation
+
+// expects lock held
+- (void)_addValue:(double)value multiplicity:(NSUInteger)multiplicity
+{
+  BOOL wasEmpty = (0 == _valueCount);
+  _sum += value * multiplicity;
+  _valueCount += multiplicity;
+
+  if (wasEmpty) {
+    _min = _max = value;
+    _minCount = _maxCount = multiplicity;
+    _extremaValid = YES;
+  } else if (_extremaValid) {
+    if (value < _min) {
+      _min = value;
+      _minCount = multiplicity;
+    } else if (value == _min) {
+      _minCount += multiplicity;
+    }
+    if (value > _max) {
+      _max = value;
+      _maxCount = multiplicity;
+    } else if (value == _max) {
+      _maxCount += multiplicity;
+    }
+  }
+}
+
+// expects lock held
+- (void)_removeValue:(double)value multiplicity:(NSUInteger)multiplicity
+{
+  _valueCount -= multiplicity;
+  if (0 == _valueCount) {
+    // reset to avoid accumulating floating point error
+    _sum = 0;
+    _extremaValid = YES;
+    return;
+  }
+
+  _sum -= value * multiplicity;
+  if (_extremaValid) {
+    if (value == _min) {
+      _minCount -= multiplicity;
+    }
+    if (value == _max) {
+      _maxCount -= multiplicity;
+    }
+    // extremum vacated; recompute lazily on next snapshot
+    if (0 == _minCount || 0 == _maxCount) {
+      _extremaValid = NO;
+    }
+  }
+}
+
+// expects lock held
+- (void)_recomputeExtrema
+{
+  BOOL first = YES;
+  for (id element in _entries) {
+    _FBKVOAggregateEntry *entry = [_entries objectForKey:element];
+    if (!entry->_hasValue) {
+      continue;
+    }
+    double value = entry->_value;
+    if (first || value < _min) {
+      _min = value;
+      _minCount = 0;
+    }
+    if (first || value > _max) {
+      _max = value;
+      _maxCount = 0;
+    }
+    if (value == _min) {
+      _minCount += entry->_multiplicity;
+    }
+    if (value == _max) {
+      _maxCount += entry->_multiplicity;
+    }
+    first = NO;
+  }
+  _extremaValid = YES;
+}
+
+- (FBKVOAggregate *)_snapshot
+{
+  pthread_mutex_lock(&_mutex);
+  if (!_extremaValid) {
+    [self _recomputeExtrema];
+  }
+  BOOL hasValues = (0 != _valueCount);
+  FBKVOAggregate *aggregate = [[FBKVOAggregate alloc] initWithCount:_count
+                                                                sum:_sum
+                                                            minimum:hasValues ? @(_min) : nil
+                                                            maximum:hasValues ? @(_max) : nil];
   pthread_mutex_unlock(&_mutex);
+  return aggregate;
+}
 
-  // add observer
-  [object addObserver:self forKeyPath:info->_keyPath options:info->_options context:(void *)info];
+- (void)_notify
+{
+  // take strong references
+  FBKVOController *controller = _controller;
+  id observer = controller.observer;
+  id object = _object;
+  if (nil == observer || nil == object) {
+    return;
+  }
 
-  if (info->_state == _FBKVOInfoStateInitial) {
-    info->_state = _FBKVOInfoStateObserving;
-  } else if (info->_state == _FBKVOInfoStateNotObserving) {
-    // this could happen when `NSKeyValueObservingOptionInitial` is one of the NSKeyValueObservingOptions,
-    // and the observer is unregistered within the callback block.
-    // at this time the object has been registered as an observer (in Foundation KVO),
-    // so we can safely unobserve it.
-    [object removeObserver:self forKeyPath:info->_keyPath context:(void *)info];
+  FBKVOAggregate *aggregate = [self _snapshot];
+  if (NULL == _queue || is_current_queue(_queue)) {
+    _block(observer, object, aggregate);
+    return;
   }
+
+  // element changes arrive on the thread of the change, deliver on the queue of the collection, in flight for flushes
+  FBKVOAggregateBlock block = _block;
+  dispatch_async(_queue, counted_block(controller, ^{
+    block(observer, object, aggregate);
+  }));
 }
 
-- (void)unobserve:(id)object info:(nullable _FBKVOInfo *)info
+#pragma mark Elements
+
+- (void)_insertElement:(id)element
 {
-  if (nil == info) {
+  pthread_mutex_lock(&_mutex);
+  _FBKVOAggregateEntry *entry = [_entries objectForKey:element];
+  BOOL isNew = (nil == entry);
+  if (isNew) {
+    // value resolved by the initial element notification
+    entry = [[_FBKVOAggregateEntry alloc] init];
+    [_entries setObject:entry forKey:element];
+  } else if (entry->_hasValue) {
+    [self _addValue:entry->_value multiplicity:1];
+  }
+  entry->_multiplicity++;
+  _count++;
+  pthread_mutex_unlock(&_mutex);
+
+  if (isNew) {
+    [_elementController observe:element keyPath:_elementKeyPath options:NSKeyValueObservingOptionInitial|NSKeyValueObservingOptionNew block:^(_FBKVOAggregateTracker *tracker, id changedElement, NSDictionary<NSString *, id> *change) {
+      [tracker _element:changedElement didChangeValue:change[NSKeyValueChangeNewKey]];
+    }];
+  }
+}
+
+- (void)_removeElement:(id)element
+{
+  pthread_mutex_lock(&_mutex);
+  _FBKVOAggregateEntry *entry = [_entries objectForKey:element];
+  BOOL isGone = NO;
+  if (nil != entry) {
+    if (entry->_hasValue) {
+      [self _removeValue:entry->_value multiplicity:1];
+    }
+    entry->_multiplicity--;
+    _count--;
+    if (0 == entry->_multiplicity) {
+      [_entries removeObjectForKey:element];
+      isGone = YES;
+    }
+  }
+  pthread_mutex_unlock(&_mutex);
+
+  if (isGone) {
+    [_elementController unobserve:element keyPath:_elementKeyPath];
+  }
+}
+
+- (void)_removeAllElements
+{
+  pthread_mutex_lock(&_mutex);
+  [_entries removeAllObjects];
+  _count = 0;
+  _valueCount = 0;
+  _sum = 0;
+  _extremaValid = YES;
+  pthread_mutex_unlock(&_mutex);
+
+  [_elementController unobserveAll];
+}
+
+- (void)_element:(id)element didChangeValue:(nullable id)value
+{
+  pthread_mutex_lock(&_mutex);
+  _FBKVOAggregateEntry *entry = [_entries objectForKey:element];
+  if (nil == entry) {
+    // element removed concurrently
+    pthread_mutex_unlock(&_mutex);
+    return;
+  }
+
+  if (entry->_hasValue) {
+    [self _removeValue:entry->_value multiplicity:entry->_multiplicity];
+  }
+  entry->_hasValue = [value isKindOfClass:[NSNumber class]];
+  if (entry->_hasValue) {
+    entry->_value = [value doubleValue];
+    [self _addValue:entry->_value multiplicity:entry->_multiplicity];
+  }
+
+  // notifications are coalesced while applying a collection change
+  BOOL notify = (0 == _batchDepth);
+  pthread_mutex_unlock(&_mutex);
+
+  if (notify) {
+    [self _notify];
+  }
+}
+
+#pragma mark Collection
+
+- (void)applyCollectionChange:(NSDictionary<NSString *, id> *)change
+{
+  pthread_mutex_lock(&_mutex);
+  _batchDepth++;
+  pthread_mutex_unlock(&_mutex);
+
+  NSKeyValueChange kind = [change[NSKeyValueChangeKindKey] unsignedIntegerValue];
+  if (NSKeyValueChangeSetting == kind) {
+    [self _removeAllElements];
+  }
+  if (NSKeyValueChangeRemoval == kind || NSKeyValueChangeReplacement == kind) {
+    for (id element in collection_elements(change[NSKeyValueChangeOldKey])) {
+      [self _removeElement:element];
+    }
+  }
+  if (NSKeyValueChangeRemoval != kind) {
+    for (id element in collection_elements(change[NSKeyValueChangeNewKey])) {
+      [self _insertElement:element];
+    }
+  }
+
+  pthread_mutex_lock(&_mutex);
+  _batchDepth--;
+  pthread_mutex_unlock(&_mutex);
+
+  [self _notify];
+}
+
+@end
+
+#pragma mark FBKVOComputed -
+
+static NSString *const FBKVOComputedValueKey = @"value";
+
+@implementation FBKVOComputed
+{
+  FBKVOComputedBlock _block;
+  FBKVOController *_dependencyController;
+
+  // observed object key path dependencies
+  NSMapTable<id, NSMutableSet<NSString *> *> *_dependencies;
+  // computed dependencies, linked directly
+  NSHashTable<FBKVOComputed *> *_upstream;
+  // computeds depending on this one
+  NSHashTable<FBKVOComputed *> *_downstream;
+
+  // dependencies read during the current evaluation
+  NSMapTable<id, NSMutableSet<NSString *> *> *_collectedDependencies;
+  NSHashTable<FBKVOComputed *> *_collectedUpstream;
+
+  id _value;
+  id _publishedValue;
+  BOOL _dirty;
+  BOOL _evaluating;
+  BOOL _publishing;
+  pthread_mutex_t _mutex;
+}
+
++ (instancetype)computedWithBlock:(FBKVOComputedBlock)block
+{
+  return [[self alloc] initWithBlock:block];
+}
+
++ (BOOL)automaticallyNotifiesObserversForKey:(NSString *)key
+{
+  if ([key isEqualToString:FBKVOComputedValueKey]) {
+    return NO;
+  }
+  return [super automaticallyNotifiesObserversForKey:key];
+}
+
+- (instancetype)initWithBlock:(FBKVOComputedBlock)block
+{
+  NSParameterAssert(block);
+  self = [super init];
+  if (nil != self) {
+    _block = [block copy];
+    _dependencyController = [[FBKVOController alloc] initWithObserver:self retainObserved:YES];
+    // dependencies invalidate synchronously, whatever the global default queue
+    _dependencyController.defaultQueue = NULL;
+    _dependencies = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsStrongMemory|NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+    _upstream = [[NSHashTable alloc] initWithOptions:NSPointerFunctionsStrongMemory|NSPointerFunctionsObjectPointerPersonality capacity:0];
+    _downstream = [[NSHashTable alloc] initWithOptions:NSPointerFunctionsWeakMemory|NSPointerFunctionsObjectPointerPersonality capacity:0];
+
+    // recursive, since observers and dependent computeds may read the value while it is being published
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    // collect initial dependencies
+    pthread_mutex_lock(&_mutex);
+    [self _evaluate];
+    _publishedValue = _value;
+    pthread_mutex_unlock(&_mutex);
+  }
+  return self;
+}
+
+- (void)dealloc
+{
+  [_dependencyController unobserveAll];
+  pthread_mutex_destroy(&_mutex);
+}
+
+- (NSString *)debugDescription
+{
+  pthread_mutex_lock(&_mutex);
+  NSString *s = [NSString stringWithFormat:@"<%@:%p value:%@ dirty:%d dependencies:%lu upstream:%lu downstream:%lu>", NSStringFromClass([self class]), self, _value, _dirty, (unsigned long)_dependencies.count, (unsigned long)_upstream.count, (unsigned long)_downstream.count];
+  pthread_mutex_unlock(&_mutex);
+  return s;
+}
+
+#pragma mark Evaluation
+
+// expects lock held
+- (void)_evaluate
+{
+  NSAssert(!_evaluating, @"computed %@ depends on itself", self);
+
+  _collectedDependencies = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsStrongMemory|NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+  _collectedUpstream = [[NSHashTable alloc] initWithOptions:NSPointerFunctionsStrongMemory|NSPointerFunctionsObjectPointerPersonality capacity:0];
+
+  _evaluating = YES;
+  id value = _block(self);
+  _evaluating = NO;
+
+  // stop observing dependencies no longer read
+  for (id object in _dependencies) {
+    NSSet<NSString *> *collectedKeyPaths = [_collectedDependencies objectForKey:object];
+    for (NSString *keyPath in [_dependencies objectForKey:object]) {
+      if (![collectedKeyPaths containsObject:keyPath]) {
+        [_dependencyController unobserve:object keyPath:keyPath];
+      }
+    }
+  }
+  for (FBKVOComputed *upstream in _upstream) {
+    if (![_collectedUpstream containsObject:upstream]) {
+      [upstream _removeDownstream:self];
+    }
+  }
+
+  _dependencies = _collectedDependencies;
+  _upstream = _collectedUpstream;
+  _collectedDependencies = nil;
+  _collectedUpstream = nil;
+
+  _value = value;
+  _dirty = NO;
+}
+
+- (nullable id)valueForObject:(id)object keyPath:(NSString *)keyPath
+{
+  NSAssert(_evaluating, @"valueForObject:keyPath: called outside of computed block evaluation");
+  NSAssert(nil != object && 0 != keyPath.length, @"missing required parameters valueForObject:%@ keyPath:%@", object, keyPath);
+  if (nil == object || 0 == keyPath.length) {
+    return nil;
+  }
+
+  // direct dependency on another computed
+  if ([object isKindOfClass:[FBKVOComputed class]] && [keyPath isEqualToString:FBKVOComputedValueKey]) {
+    FBKVOComputed *upstream = object;
+    if (![_collectedUpstream containsObject:upstream]) {
+      [_collectedUpstream addObject:upstream];
+      if (![_upstream containsObject:upstream]) {
+        [upstream _addDownstream:self];
+      }
+    }
+    return upstream.value;
+  }
+
+  NSMutableSet<NSString *> *collectedKeyPaths = [_collectedDependencies objectForKey:object];
+  if (nil == collectedKeyPaths) {
+    collectedKeyPaths = [NSMutableSet set];
+    [_collectedDependencies setObject:collectedKeyPaths forKey:object];
+  }
+  if (![collectedKeyPaths containsObject:keyPath]) {
+    [collectedKeyPaths addObject:keyPath];
+    if (![[_dependencies objectForKey:object] containsObject:keyPath]) {
+      // prior notification marks stale, post notification refreshes
+      [_dependencyController observe:object keyPath:keyPath options:NSKeyValueObservingOptionPrior block:^(FBKVOComputed *computed, id changedObject, NSDictionary<NSString *, id> *change) {
+        if ([change[NSKeyValueChangeNotificationIsPriorKey] boolValue]) {
+          [computed _invalidate];
+        } else {
+          [computed _refresh];
+        }
+      }];
+    }
+  }
+  return [object valueForKeyPath:keyPath];
+}
+
+- (nullable id)value
+{
+  pthread_mutex_lock(&_mutex);
+  id value;
+  if (_publishing) {
+    // observers are reading the old value
+    value = _publishedValue;
+  } else {
+    if (_dirty) {
+      [self _evaluate];
+      if (![self _isObserved]) {
+        _publishedValue = _value;
+      }
+    }
+    value = _value;
+  }
+  pthread_mutex_unlock(&_mutex);
+  return value;
+}
+
+#pragma mark Propagation
+
+- (void)_addDownstream:(FBKVOComputed *)computed
+{
+  pthread_mutex_lock(&_mutex);
+  [_downstream addObject:computed];
+  pthread_mutex_unlock(&_mutex);
+}
+
+- (void)_removeDownstream:(FBKVOComputed *)computed
+{
+  pthread_mutex_lock(&_mutex);
+  [_downstream removeObject:computed];
+  pthread_mutex_unlock(&_mutex);
+}
+
+// expects lock held
+- (BOOL)_isObserved
+{
+  return NULL != self.observationInfo || 0 != _downstream.count;
+}
+
+- (void)_invalidate
+{
+  pthread_mutex_lock(&_mutex);
+  if (_dirty) {
+    // downstream already invalidated
+    pthread_mutex_unlock(&_mutex);
     return;
   }
+  _dirty = YES;
+  NSArray<FBKVOComputed *> *downstream = _downstream.allObjects;
+  pthread_mutex_unlock(&_mutex);
+
+  for (FBKVOComputed *computed in downstream) {
+    [computed _invalidate];
+  }
+}
+
+- (void)_refresh
+{
+  pthread_mutex_lock(&_mutex);
+
+  // unobserved values stay stale until read
+  if (_dirty && [self _isObserved]) {
+    [self _evaluate];
+  }
+
+  id value = _value;
+  BOOL changed = !_dirty && value != _publishedValue && ![value isEqual:_publishedValue];
+  if (changed) {
+    // observers read the published value until it is replaced
+    _publishing = YES;
+  }
+  NSArray<FBKVOComputed *> *downstream = changed ? _downstream.allObjects : nil;
+
+  pthread_mutex_unlock(&_mutex);
+
+  // notify unlocked, so locks are only ever nested from downstream to upstream during evaluation
+  if (changed) {
+    [self willChangeValueForKey:FBKVOComputedValueKey];
+    pthread_mutex_lock(&_mutex);
+    _publishing = NO;
+    _publishedValue = value;
+    pthread_mutex_unlock(&_mutex);
+    [self didChangeValueForKey:FBKVOComputedValueKey];
+  }
+
+  for (FBKVOComputed *computed in downstream) {
+    [computed _refresh];
+  }
+}
+
+@end
+
+#pragma mark FBKVOSnapshot -
+
+@interface FBKVOSnapshot ()
+- (instancetype)initWithObjects:(NSArray *)objects keyPaths:(NSArray<NSString *> *)keyPaths values:(NSArray *)values;
+@end
+
+@implementation FBKVOSnapshot
+{
+  NSArray *_objects;
+  NSArray<NSString *> *_keyPaths;
+  NSArray *_values;
+}
+
+- (instancetype)initWithObjects:(NSArray *)objects keyPaths:(NSArray<NSString *> *)keyPaths values:(NSArray *)values
+{
+  self = [super init];
+  if (nil != self) {
+    _objects = objects;
+    _keyPaths = keyPaths;
+    _values = values;
+  }
+  return self;
+}
+
+- (NSUInteger)count
+{
+  return _values.count;
+}
+
+- (nullable id)objectAtIndexedSubscript:(NSUInteger)index
+{
+  id value = _values[index];
+  return value == [NSNull null] ? nil : value;
+}
+
+- (nullable id)valueForObject:(id)object keyPath:(NSString *)keyPath
+{
+  for (NSUInteger idx = 0; idx < _objects.count; idx++) {
+    if (_objects[idx] == object && [_keyPaths[idx] isEqualToString:keyPath]) {
+      return self[idx];
+    }
+  }
+  return nil;
+}
+
+- (NSString *)debugDescription
+{
+  return [NSString stringWithFormat:@"<%@:%p keyPaths:%@ values:%@>", NSStringFromClass([self class]), self, _keyPaths, _values];
+}
+
+@end
+
+/**
+ @abstract Collects the latest values of several sources, and coalesces delivery per queue turn.
+ @discussion Retained by the source observation blocks.
+ */
+@interface _FBKVOCombiner : NSObject
+@end
+
+@implementation _FBKVOCombiner
+{
+  __weak FBKVOController *_controller;
+  NSArray *_objects;
+  NSArray<NSString *> *_keyPaths;
+  // delivering queue, coalescing changes per turn
+  dispatch_queue_t _queue;
+  FBKVOCombineLatestBlock _block;
+  NSMutableArray *_latest;
+  BOOL _scheduled;
+  pthread_mutex_t _mutex;
+}
+
+- (instancetype)initWithController:(FBKVOController *)controller objects:(NSArray *)objects keyPaths:(NSArray<NSString *> *)keyPaths queue:(dispatch_queue_t)queue block:(FBKVOCombineLatestBlock)block
+{
+  self = [super init];
+  if (nil != self) {
+    _controller = controller;
+    _objects = [objects copy];
+    _keyPaths = [keyPaths copy];
+    _queue = queue;
+    _block = [block copy];
+    _latest = [NSMutableArray arrayWithCapacity:objects.count];
+    for (NSUInteger idx = 0; idx < objects.count; idx++) {
+      [_latest addObject:[NSNull null]];
+    }
+    pthread_mutex_init(&_mutex, NULL);
+  }
+  return self;
+}
+
+- (void)dealloc
+{
+  pthread_mutex_destroy(&_mutex);
+}
 
-  // unregister info
+- (void)setValue:(nullable id)value atIndex:(NSUInteger)index
+{
   pthread_mutex_lock(&_mutex);
-  [_infos removeObject:info];
+  _latest[index] = value ?: [NSNull null];
+  BOOL schedule = !_scheduled;
+  _scheduled = YES;
   pthread_mutex_unlock(&_mutex);
 
-  // remove observer
-  if (info->_state == _FBKVOInfoStateObserving) {
-    [object removeObserver:self forKeyPath:info->_keyPath context:(void *)info];
+  // at most one pending delivery, in flight for flushes
+  if (schedule) {
+    FBKVOController *controller = _controller;
+    if (nil != controller) {
+      dispatch_async(_queue, counted_block(controller, ^{
+        [self _deliver];
+      }));
+    }
   }
-  info->_state = _FBKVOInfoStateNotObserving;
 }
 
-- (void)unobserve:(id)object infos:(nullable NSSet<_FBKVOInfo *> *)infos
+- (void)_deliver
 {
-  if (0 == infos.count) {
-    return;
-  }
-
-  // unregister info
   pthread_mutex_lock(&_mutex);
-  for (_FBKVOInfo *info in infos) {
-    [_infos removeObject:info];
-  }
+  _scheduled = NO;
+  NSArray *values = [_latest copy];
   pthread_mutex_unlock(&_mutex);
 
-  // remove observer
-  for (_FBKVOInfo *info in infos) {
-    if (info->_state == _FBKVOInfoStateObserving) {
-      [object removeObserver:self forKeyPath:info->_keyPath context:(void *)info];
-    }
-    info->_state = _FBKVOInfoStateNotObserving;
+  // take strong references
+  FBKVOController *controller = _controller;
+  id observer = controller.observer;
+  if (nil == observer) {
+    return;
   }
+
+  FBKVOSnapshot *snapshot = [[FBKVOSnapshot alloc] initWithObjects:_objects keyPaths:_keyPaths values:values];
+  _block(observer, snapshot);
 }
 
-- (void)observeValueForKeyPath:(nullable NSString *)keyPath
-                      ofObject:(nullable id)object
-                        change:(nullable NSDictionary<NSString *, id> *)change
-                       context:(nullable void *)context
-{
-  NSAssert(context, @"missing context keyPath:%@ object:%@ change:%@", keyPath, object, change);
+@end
 
-  _FBKVOInfo *info;
+#pragma mark _FBKVOWaiter -
 
-  {
-    // lookup context in registered infos, taking out a strong reference only if it exists
-    pthread_mutex_lock(&_mutex);
-    info = [_infos member:(__bridge id)context];
-    pthread_mutex_unlock(&_mutex);
+/**
+ @abstract Observer of a key path waited on, counting changes under a condition variable.
+ */
+@interface _FBKVOWaiter : NSObject
+@end
+
+@implementation _FBKVOWaiter
+{
+@public
+  pthread_mutex_t _mutex;
+  pthread_cond_t _condition;
+  // incremented on every change, guarded by mutex
+  uint64_t _generation;
+}
+
+- (instancetype)init
+{
+  self = [super init];
+  if (nil != self) {
+    pthread_mutex_init(&_mutex, NULL);
+    pthread_cond_init(&_condition, NULL);
   }
+  return self;
+}
 
-  if (nil != info) {
+- (void)dealloc
+{
+  pthread_cond_destroy(&_condition);
+  pthread_mutex_destroy(&_mutex);
+}
 
-    // take strong reference to controller
-    FBKVOController *controller = info->_controller;
-    if (nil != controller) {
+- (void)signal
+{
+  pthread_mutex_lock(&_mutex);
+  _generation++;
+  pthread_cond_broadcast(&_condition);
+  pthread_mutex_unlock(&_mutex);
+}
 
-      // take strong reference to observer
-      id observer = controller.observer;
-      if (nil != observer) {
-
-        // dispatch custom block or action, fall back to default action
-        if (info->_block) {
-          if (info->_queue && ! (info->_queue == dispatch_get_main_queue() && is_main_queue()) ) {
-            dispatch_async(info->_queue, ^{ info->_block(observer, object, change); });
-          } else {
-            info->_block(observer, object, change);
-          }
-        } else if (info->_action) {
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Warc-performSelector-leaks"
-          if (info->_queue && ! (info->_queue == dispatch_get_main_queue() && is_main_queue()) ) {
-            dispatch_async(info->_queue, ^{ [observer performSelector:info->_action withObject:change withObject:object]; });
-          } else {
-            [observer performSelector:info->_action withObject:change withObject:object];
-          }
-#pragma clang diagnostic pop
-        } else {
-          if (info->_queue && ! (info->_queue == dispatch_get_main_queue() && is_main_queue()) ) {
-            dispatch_async(info->_queue, ^{ [observer observeValueForKeyPath:keyPath ofObject:object change:change context:info->_context]; });
-          } else {
-            [observer observeValueForKeyPath:keyPath ofObject:object change:change context:info->_context];
-          }
-        }
-      }
+- (uint64_t)generation
+{
+  pthread_mutex_lock(&_mutex);
+  uint64_t generation = _generation;
+  pthread_mutex_unlock(&_mutex);
+  return generation;
+}
+
+/** waits for a change past generation, returning NO on deadline */
+- (BOOL)waitPastGeneration:(uint64_t)generation deadline:(const struct timespec *)deadline
+{
+  BOOL changed = YES;
+  pthread_mutex_lock(&_mutex);
+  while (_generation == generation) {
+    if (ETIMEDOUT == pthread_cond_timedwait(&_condition, &_mutex, deadline)) {
+      changed = (_generation != generation);
+      break;
     }
   }
+  pthread_mutex_unlock(&_mutex);
+  return changed;
 }
 
 @end
@@ -425,6 +3379,11 @@ typedef NS_ENUM(uint8_t, _FBKVOInfoState) {
 @implementation FBKVOController
 {
   NSMapTable<id, NSMutableSet<_FBKVOInfo *> *> *_objectInfosMap;
+  // notifications retained while paused, guarded by lock
+  _FBKVONotificationBuffer *_pausedNotifications;
+  // the assigned default queue, guarded by lock; the global default applies until assigned
+  dispatch_queue_t _defaultQueue;
+  BOOL _hasDefaultQueue;
   pthread_mutex_t _lock;
 }
 
@@ -443,6 +3402,8 @@ typedef NS_ENUM(uint8_t, _FBKVOInfoState) {
     NSPointerFunctionsOptions keyOptions = retainObserved ? NSPointerFunctionsStrongMemory|NSPointerFunctionsObjectPointerPersonality : NSPointerFunctionsWeakMemory|NSPointerFunctionsObjectPointerPersonality;
     _objectInfosMap = [[NSMapTable alloc] initWithKeyOptions:keyOptions valueOptions:NSPointerFunctionsStrongMemory|NSPointerFunctionsObjectPersonality capacity:0];
     pthread_mutex_init(&_lock, NULL);
+    pthread_mutex_init(&_flushMutex, NULL);
+    pthread_cond_init(&_flushCondition, NULL);
   }
   return self;
 }
@@ -456,6 +3417,8 @@ typedef NS_ENUM(uint8_t, _FBKVOInfoState) {
 {
   [self unobserveAll];
   pthread_mutex_destroy(&_lock);
+  pthread_cond_destroy(&_flushCondition);
+  pthread_mutex_destroy(&_flushMutex);
 }
 
 #pragma mark Properties -
@@ -484,137 +3447,513 @@ typedef NS_ENUM(uint8_t, _FBKVOInfoState) {
   // unlock
   pthread_mutex_unlock(&_lock);
 
-  [s appendString:@">"];
-  return s;
+  [s appendString:@">"];
+  return s;
+}
+
+#pragma mark Utilities -
+
+- (nullable _FBKVOInfo *)_registeredInfo:(_FBKVOInfo *)info object:(id)object
+{
+  pthread_mutex_lock(&_lock);
+  _FBKVOInfo *registeredInfo = [[_objectInfosMap objectForKey:object] member:info];
+  pthread_mutex_unlock(&_lock);
+  return registeredInfo;
+}
+
+- (BOOL)_withholdNotificationForInfo:(_FBKVOInfo *)info object:(nullable id)object keyPath:(nullable NSString *)keyPath change:(nullable NSDictionary<NSString *, id> *)change
+{
+  // pause state is cleared under lock once retained notifications are drained, so recheck it
+  pthread_mutex_lock(&_lock);
+  uint8_t pauseState = MAX(atomic_load_explicit(&_pauseState, memory_order_relaxed),
+                           atomic_load_explicit(&info->_pauseState, memory_order_relaxed));
+  if (_FBKVOPauseStateRetaining == pauseState) {
+    if (nil == _pausedNotifications) {
+      _pausedNotifications = [[_FBKVONotificationBuffer alloc] initWithLimit:FBKVO_PAUSED_CHANGES_LIMIT];
+    }
+    [_pausedNotifications addInfo:info object:object keyPath:keyPath change:change];
+  }
+  pthread_mutex_unlock(&_lock);
+  return _FBKVOPauseStateNone != pauseState;
+}
+
+- (void)_resumeInfosPassingTest:(BOOL (^)(_FBKVOInfo *info))predicate clearing:(dispatch_block_t)clear
+{
+  _FBKVOThreadState *state = current_thread_state();
+  __unsafe_unretained FBKVOController *resumingController = state->_resumingController;
+  BOOL (^resumingPredicate)(_FBKVOInfo *) = state->_resumingPredicate;
+  state->_resumingController = self;
+  state->_resumingPredicate = predicate;
+
+  // drain until empty, retaining notifications arriving meanwhile so they follow those already retained
+  for (;;) {
+    pthread_mutex_lock(&_lock);
+    NSArray<_FBKVOBufferedNotification *> *entries = [_pausedNotifications takeSortedEntriesPassingTest:predicate];
+    if (0 == entries.count) {
+      clear();
+      pthread_mutex_unlock(&_lock);
+      break;
+    }
+    pthread_mutex_unlock(&_lock);
+
+    [[_FBKVOSharedController sharedController] notifyBufferedNotifications:entries];
+  }
+
+  state->_resumingController = resumingController;
+  state->_resumingPredicate = resumingPredicate;
+}
+
+- (void)_observe:(id)object info:(_FBKVOInfo *)info
+{
+  // lock
+  pthread_mutex_lock(&_lock);
+
+  NSMutableSet *infos = [_objectInfosMap objectForKey:object];
+
+  // check for info existence
+  _FBKVOInfo *existingInfo = [infos member:info];
+  if (nil != existingInfo) {
+    // observation info already exists; do not observe it again
+
+    // unlock and return
+    pthread_mutex_unlock(&_lock);
+    return;
+  }
+
+  // lazilly create set of infos
+  if (nil == infos) {
+    infos = [NSMutableSet set];
+    [_objectInfosMap setObject:infos forKey:object];
+  }
+
+  // add info and oberve
+  [infos addObject:info];
+
+  // unlock prior to callout
+  pthread_mutex_unlock(&_lock);
+
+  [[_FBKVOSharedController sharedController] observe:object info:info];
+}
+
+- (void)_unobserve:(id)object info:(_FBKVOInfo *)info
+{
+  [self _unobserve:object info:info async:NO];
+}
+
+- (void)_unobserve:(id)object info:(_FBKVOInfo *)info async:(BOOL)async
+{
+  // lock
+  pthread_mutex_lock(&_lock);
+
+  // get observation infos
+  NSMutableSet *infos = [_objectInfosMap objectForKey:object];
+
+  // lookup registered info instance
+  _FBKVOInfo *registeredInfo = [infos member:info];
+
+  // a representative info also matches combined sources of the key path, function observations only themselves
+  NSSet<_FBKVOInfo *> *registeredInfos;
+  if (registeredInfo == info) {
+    registeredInfos = [NSSet setWithObject:info];
+  } else if (NULL != info->_function) {
+    registeredInfos = nil;
+  } else {
+    NSString *keyPath = info->_keyPath;
+    registeredInfos = [infos objectsPassingTest:^BOOL(_FBKVOInfo *registered, BOOL *stop) {
+      return [registered->_keyPath isEqualToString:keyPath];
+    }];
+  }
+
+  if (0 != registeredInfos.count) {
+    [infos minusSet:registeredInfos];
+
+    // remove no longer used infos
+    if (0 == infos.count) {
+      [_objectInfosMap removeObjectForKey:object];
+    }
+  }
+
+  // unlock
+  pthread_mutex_unlock(&_lock);
+
+  // unobserve
+  if (async) {
+    [[_FBKVOSharedController sharedController] unobserveAsync:object infos:registeredInfos];
+  } else {
+    [[_FBKVOSharedController sharedController] unobserve:object infos:registeredInfos];
+  }
+}
+
+- (void)_unobserve:(id)object
+{
+  [self _unobserve:object async:NO];
+}
+
+- (void)_unobserve:(id)object async:(BOOL)async
+{
+  // lock
+  pthread_mutex_lock(&_lock);
+
+  NSMutableSet *infos = [_objectInfosMap objectForKey:object];
+
+  // remove infos
+  [_objectInfosMap removeObjectForKey:object];
+
+  // unlock
+  pthread_mutex_unlock(&_lock);
+
+  // unobserve
+  if (async) {
+    [[_FBKVOSharedController sharedController] unobserveAsync:object infos:infos];
+  } else {
+    [[_FBKVOSharedController sharedController] unobserve:object infos:infos];
+  }
+}
+
+- (void)_unobserveAll
+{
+  // lock
+  pthread_mutex_lock(&_lock);
+
+  NSMapTable *objectInfoMaps = [_objectInfosMap copy];
+
+  // clear table and map
+  [_objectInfosMap removeAllObjects];
+
+  // unlock
+  pthread_mutex_unlock(&_lock);
+
+  _FBKVOSharedController *shareController = [_FBKVOSharedController sharedController];
+
+  for (id object in objectInfoMaps) {
+    // unobserve each registered object and infos
+    NSSet *infos = [objectInfoMaps objectForKey:object];
+    [shareController unobserve:object infos:infos];
+  }
+}
+
+#pragma mark API -
+
++ (void)setObserveOnMainQueueByDefault:(BOOL)observeOnMainQueueByDefault
+{
+  [_FBKVOSharedController sharedController].defaultQueue = observeOnMainQueueByDefault ? dispatch_get_main_queue() : NULL;
+}
+
++ (BOOL)observeOnMainQueueByDefault
+{
+  return [_FBKVOSharedController sharedController].defaultQueue == dispatch_get_main_queue();
+}
+
+- (dispatch_queue_t)defaultQueue
+{
+  pthread_mutex_lock(&_lock);
+  dispatch_queue_t queue = _hasDefaultQueue ? _defaultQueue : [_FBKVOSharedController sharedController].defaultQueue;
+  pthread_mutex_unlock(&_lock);
+  return queue;
+}
+
+- (void)setDefaultQueue:(dispatch_queue_t)defaultQueue
+{
+  pthread_mutex_lock(&_lock);
+  _defaultQueue = defaultQueue;
+  _hasDefaultQueue = YES;
+  pthread_mutex_unlock(&_lock);
+}
+
+- (void)setObserveOnMainQueueByDefault:(BOOL)observeOnMainQueueByDefault
+{
+  self.defaultQueue = observeOnMainQueueByDefault ? dispatch_get_main_queue() : NULL;
+}
+
+- (BOOL)observeOnMainQueueByDefault
+{
+  return self.defaultQueue == dispatch_get_main_queue();
+}
+
+- (BOOL)flushWithTimeout:(NSTimeInterval)timeout
+{
+  struct timespec deadline = deadline_after(timeout);
+
+  pthread_mutex_lock(&_flushMutex);
+  BOOL flushed = YES;
+  while (0 != atomic_load_explicit(&_inflight, memory_order_acquire)) {
+    if (ETIMEDOUT == pthread_cond_timedwait(&_flushCondition, &_flushMutex, &deadline)) {
+      flushed = (0 == atomic_load_explicit(&_inflight, memory_order_acquire));
+      break;
+    }
+  }
+  pthread_mutex_unlock(&_flushMutex);
+  return flushed;
+}
+
+- (void)flushWithCompletion:(dispatch_block_t)completion
+{
+  NSAssert(NULL != completion, @"missing required parameter completion");
+  if (NULL == completion) {
+    return;
+  }
+
+  pthread_mutex_lock(&_flushMutex);
+  BOOL flushed = (0 == atomic_load_explicit(&_inflight, memory_order_acquire));
+  if (!flushed) {
+    if (nil == _flushCompletions) {
+      _flushCompletions = [NSMutableArray array];
+    }
+    [_flushCompletions addObject:[completion copy]];
+  }
+  pthread_mutex_unlock(&_flushMutex);
+
+  if (flushed) {
+    completion();
+  }
+}
+
+- (void)setSerial:(BOOL)serial
+{
+  if (serial) {
+    pthread_mutex_lock(&_lock);
+    if (nil == _actor) {
+      _actor = [[_FBKVOMailbox alloc] initWithPool:shared_worker_pool()];
+    }
+    pthread_mutex_unlock(&_lock);
+  }
+  atomic_store_explicit(&_serial, serial, memory_order_release);
 }
 
-#pragma mark Utilities -
+- (BOOL)isSerial
+{
+  return atomic_load_explicit(&_serial, memory_order_acquire);
+}
 
-- (void)_observe:(id)object info:(_FBKVOInfo *)info
++ (void)setMaximumNotificationDepth:(NSUInteger)maximumNotificationDepth
 {
-  // lock
-  pthread_mutex_lock(&_lock);
+  [_FBKVOSharedController sharedController].maximumDepth = MAX(maximumNotificationDepth, 1u);
+}
 
-  NSMutableSet *infos = [_objectInfosMap objectForKey:object];
++ (NSUInteger)maximumNotificationDepth
+{
+  return [_FBKVOSharedController sharedController].maximumDepth;
+}
 
-  // check for info existence
-  _FBKVOInfo *existingInfo = [infos member:info];
-  if (nil != existingInfo) {
-    // observation info already exists; do not observe it again
++ (void)setNotificationCycleHandler:(nullable void (^)(NSArray<NSString *> *keyPaths))handler
+{
+  [_FBKVOSharedController sharedController].cycleHandler = handler;
+}
 
-    // unlock and return
-    pthread_mutex_unlock(&_lock);
-    return;
++ (void)beginTransaction
+{
+  _FBKVOThreadState *state = current_thread_state();
+  if (nil == state->_transaction) {
+    state->_transaction = [[_FBKVONotificationBuffer alloc] init];
   }
+  state->_transactionDepth++;
+}
 
-  // lazilly create set of infos
-  if (nil == infos) {
-    infos = [NSMutableSet set];
-    [_objectInfosMap setObject:infos forKey:object];
++ (void)commit
+{
+  _FBKVOThreadState *state = current_thread_state();
+  _FBKVONotificationBuffer *transaction = state->_transaction;
+  NSAssert(nil != transaction, @"commit called without matching beginTransaction");
+  if (nil == transaction || 0 != --state->_transactionDepth) {
+    return;
   }
 
-  // add info and oberve
-  [infos addObject:info];
-
-  // unlock prior to callout
-  pthread_mutex_unlock(&_lock);
+  // end the transaction prior to delivery, so that notifications caused by observers are delivered immediately
+  NSArray<_FBKVOBufferedNotification *> *entries = [transaction sortedEntries];
+  state->_transaction = nil;
 
-  [[_FBKVOSharedController sharedController] observe:object info:info];
+  [[_FBKVOSharedController sharedController] notifyBufferedNotifications:entries];
 }
 
-- (void)_unobserve:(id)object info:(_FBKVOInfo *)info
++ (BOOL)waitForObject:(id)object keyPath:(NSString *)keyPath predicate:(BOOL (^)(id _Nullable value))predicate timeout:(NSTimeInterval)timeout
 {
-  // lock
-  pthread_mutex_lock(&_lock);
+  NSAssert(nil != object && 0 != keyPath.length && NULL != predicate, @"missing required parameters waitForObject:%@ keyPath:%@ predicate:%p", object, keyPath, predicate);
+  if (nil == object || 0 == keyPath.length || NULL == predicate) {
+    return NO;
+  }
 
-  // get observation infos
-  NSMutableSet *infos = [_objectInfosMap objectForKey:object];
+  struct timespec deadline = deadline_after(timeout);
+  _FBKVOWaiter *waiter = [[_FBKVOWaiter alloc] init];
+
+  // observe prior to checking the value, so that no change is missed; always notify synchronously
+  FBKVOController *controller = [[FBKVOController alloc] initWithObserver:waiter retainObserved:NO];
+  controller.defaultQueue = NULL;
+  [controller observe:object keyPath:keyPath options:0 block:^(id observer, id changedObject, NSDictionary<NSString *, id> *change) {
+    [(_FBKVOWaiter *)observer signal];
+  }];
+
+  BOOL satisfied = NO;
+  for (;;) {
+    uint64_t generation = [waiter generation];
+    if (predicate([object valueForKeyPath:keyPath])) {
+      satisfied = YES;
+      break;
+    }
+    if (![waiter waitPastGeneration:generation deadline:&deadline]) {
+      break;
+    }
+  }
 
-  // lookup registered info instance
-  _FBKVOInfo *registeredInfo = [infos member:info];
+  // stop observing explicitly, as the controller is otherwise unused once observing begins
+  [controller unobserveAll];
+  return satisfied;
+}
+
+- (BOOL)isPaused
+{
+  return _FBKVOPauseStateNone != atomic_load_explicit(&_pauseState, memory_order_relaxed);
+}
 
-  if (nil != registeredInfo) {
-    [infos removeObject:registeredInfo];
+- (void)pause
+{
+  [self pauseRetainingLatest:NO];
+}
 
-    // remove no longer used infos
-    if (0 == infos.count) {
-      [_objectInfosMap removeObjectForKey:object];
-    }
+- (void)pauseRetainingLatest:(BOOL)retainLatest
+{
+  if (retainLatest) {
+    atomic_store_explicit(&_pauseState, _FBKVOPauseStateRetaining, memory_order_relaxed);
+    return;
   }
 
-  // unlock
+  // switching to drop discards notifications retained so far, except those of observations retaining individually
+  pthread_mutex_lock(&_lock);
+  atomic_store_explicit(&_pauseState, _FBKVOPauseStateDropping, memory_order_relaxed);
+  [_pausedNotifications takeSortedEntriesPassingTest:^BOOL(_FBKVOInfo *info) {
+    return _FBKVOPauseStateRetaining != atomic_load_explicit(&info->_pauseState, memory_order_relaxed);
+  }];
   pthread_mutex_unlock(&_lock);
-
-  // unobserve
-  [[_FBKVOSharedController sharedController] unobserve:object info:registeredInfo];
 }
 
-- (void)_unobserve:(id)object
+- (void)resume
 {
-  // lock
-  pthread_mutex_lock(&_lock);
+  // deliver retained notifications of observations not paused individually, then clear
+  [self _resumeInfosPassingTest:^BOOL(_FBKVOInfo *info) {
+    return _FBKVOPauseStateNone == atomic_load_explicit(&info->_pauseState, memory_order_relaxed);
+  } clearing:^{
+    atomic_store_explicit(&self->_pauseState, _FBKVOPauseStateNone, memory_order_relaxed);
+  }];
+}
 
-  NSMutableSet *infos = [_objectInfosMap objectForKey:object];
+- (void)pause:(nullable id)object keyPath:(NSString *)keyPath retainingLatest:(BOOL)retainLatest
+{
+  if (nil == object || 0 == keyPath.length) {
+    return;
+  }
 
-  // remove infos
-  [_objectInfosMap removeObjectForKey:object];
+  _FBKVOInfo *info = [self _registeredInfo:[[_FBKVOInfo alloc] initWithController:self keyPath:keyPath] object:object];
+  if (nil != info) {
+    atomic_store_explicit(&info->_pauseState, retainLatest ? _FBKVOPauseStateRetaining : _FBKVOPauseStateDropping, memory_order_relaxed);
+  }
+}
 
-  // unlock
-  pthread_mutex_unlock(&_lock);
+- (void)resume:(nullable id)object keyPath:(NSString *)keyPath
+{
+  if (nil == object || 0 == keyPath.length) {
+    return;
+  }
 
-  // unobserve
-  [[_FBKVOSharedController sharedController] unobserve:object infos:infos];
+  _FBKVOInfo *info = [self _registeredInfo:[[_FBKVOInfo alloc] initWithController:self keyPath:keyPath] object:object];
+  if (nil == info) {
+    return;
+  }
+  dispatch_block_t clear = ^{
+    atomic_store_explicit(&info->_pauseState, _FBKVOPauseStateNone, memory_order_relaxed);
+  };
+
+  // deliver retained notifications unless the controller is still paused, then clear
+  if (self.isPaused) {
+    pthread_mutex_lock(&_lock);
+    clear();
+    pthread_mutex_unlock(&_lock);
+  } else {
+    [self _resumeInfosPassingTest:^BOOL(_FBKVOInfo *pausedInfo) {
+      return pausedInfo == info;
+    } clearing:clear];
+  }
 }
 
-- (void)_unobserveAll
+- (void)observe:(nullable id)object keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options block:(FBKVONotificationBlock)block
 {
-  // lock
-  pthread_mutex_lock(&_lock);
+  NSAssert(0 != keyPath.length && NULL != block, @"missing required parameters observe:%@ keyPath:%@ block:%p", object, keyPath, block);
+  if (nil == object || 0 == keyPath.length || NULL == block) {
+    return;
+  }
 
-  NSMapTable *objectInfoMaps = [_objectInfosMap copy];
+  // create info
+  _FBKVOInfo *info = [[_FBKVOInfo alloc] initWithController:self keyPath:keyPath options:options block:block];
 
-  // clear table and map
-  [_objectInfosMap removeAllObjects];
+  // observe object with info
+  [self _observe:object info:info];
+}
 
-  // unlock
-  pthread_mutex_unlock(&_lock);
+- (void)observe:(nullable id)object keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options stampedBlock:(FBKVOStampedNotificationBlock)block
+{
+  NSAssert(0 != keyPath.length && NULL != block, @"missing required parameters observe:%@ keyPath:%@ block:%p", object, keyPath, block);
+  if (nil == object || 0 == keyPath.length || NULL == block) {
+    return;
+  }
 
-  _FBKVOSharedController *shareController = [_FBKVOSharedController sharedController];
+  // create info, unpacking stamps from the change for the block
+  _FBKVOInfo *info = [[_FBKVOInfo alloc] initWithController:self keyPath:keyPath options:options block:^(id observer, id changedObject, NSDictionary<NSString *, id> *change) {
+    block(observer, changedObject, change, change_stamp(change));
+  }];
+  info->_stamped = YES;
 
-  for (id object in objectInfoMaps) {
-    // unobserve each registered object and infos
-    NSSet *infos = [objectInfoMaps objectForKey:object];
-    [shareController unobserve:object infos:infos];
-  }
+  // observe object with info
+  [self _observe:object info:info];
 }
 
-#pragma mark API -
-
-+ (void)setObserveOnMainQueueByDefault:(BOOL)observeOnMainQueueByDefault
+- (void)observe:(nullable id)object keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options queue:(dispatch_queue_t)queue priority:(FBKVODeliveryPriority)priority block:(FBKVONotificationBlock)block
 {
-  [_FBKVOSharedController sharedController].defaultQueue = observeOnMainQueueByDefault ? dispatch_get_main_queue() : NULL;
+  NSAssert(0 != keyPath.length && NULL != queue && NULL != block, @"missing required parameters observe:%@ keyPath:%@ queue:%p block:%p", object, keyPath, queue, block);
+  if (nil == object || 0 == keyPath.length || NULL == queue || NULL == block) {
+    return;
+  }
+
+  // create info
+  _FBKVOInfo *info = [[_FBKVOInfo alloc] initWithController:self keyPath:keyPath options:options block:block action:NULL queue:queue context:NULL];
+  if (FBKVODeliveryPriorityDefault != priority) {
+    info->_lane = [[_FBKVOSharedController sharedController] laneForQueue:queue priority:priority];
+  }
+
+  // observe object with info
+  [self _observe:object info:info];
 }
 
-+ (BOOL)observeOnMainQueueByDefault
+- (void)observe:(nullable id)object keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options executor:(id<FBKVOExecutor>)executor block:(FBKVONotificationBlock)block
 {
-  return [_FBKVOSharedController sharedController].defaultQueue == dispatch_get_main_queue();
+  NSAssert(0 != keyPath.length && nil != executor && NULL != block, @"missing required parameters observe:%@ keyPath:%@ executor:%@ block:%p", object, keyPath, executor, block);
+  if (nil == object || 0 == keyPath.length || nil == executor || NULL == block) {
+    return;
+  }
+
+  // create info, delivered by the executor rather than a queue
+  _FBKVOInfo *info = [[_FBKVOInfo alloc] initWithController:self keyPath:keyPath options:options block:block action:NULL queue:NULL context:NULL];
+  info->_executor = executor;
+
+  // observe object with info
+  [self _observe:object info:info];
 }
 
-- (void)observe:(nullable id)object keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options block:(FBKVONotificationBlock)block
+- (void)observe:(nullable id)object keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options frameClock:(nullable id<FBKVOFrameClock>)frameClock block:(FBKVONotificationBlock)block
 {
   NSAssert(0 != keyPath.length && NULL != block, @"missing required parameters observe:%@ keyPath:%@ block:%p", object, keyPath, block);
   if (nil == object || 0 == keyPath.length || NULL == block) {
     return;
   }
 
-  // create info
-  _FBKVOInfo *info = [[_FBKVOInfo alloc] initWithController:self keyPath:keyPath options:options block:block];
+  _FBKVOFrameSampler *sampler = [[_FBKVOFrameSampler alloc] initWithClock:frameClock ?: [FBKVODispatchFrameClock sharedClock]];
+
+  // create info, delivered by the frame clock rather than a queue
+  _FBKVOInfo *info = [[_FBKVOInfo alloc] initWithController:self keyPath:keyPath options:options block:block action:NULL queue:NULL context:NULL];
+  info->_sampler = sampler;
+  sampler->_info = info;
 
   // observe object with info
   [self _observe:object info:info];
 }
 
-
 - (void)observe:(nullable id)object keyPaths:(NSArray<NSString *> *)keyPaths options:(NSKeyValueObservingOptions)options block:(FBKVONotificationBlock)block
 {
   NSAssert(0 != keyPaths.count && NULL != block, @"missing required parameters observe:%@ keyPath:%@ block:%p", object, keyPaths, block);
@@ -627,6 +3966,32 @@ typedef NS_ENUM(uint8_t, _FBKVOInfoState) {
   }
 }
 
+- (nullable id)observe:(nullable id)object keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options function:(FBKVONotificationFunction)function context:(nullable void *)context
+{
+  NSAssert(0 != keyPath.length && NULL != function, @"missing required parameters observe:%@ keyPath:%@ function:%p", object, keyPath, function);
+  if (nil == object || 0 == keyPath.length || NULL == function) {
+    return nil;
+  }
+
+  // create info, delivered synchronously whatever the default queue
+  _FBKVOInfo *info = [[_FBKVOInfo alloc] initWithController:self keyPath:keyPath options:options block:NULL action:NULL queue:NULL context:context];
+  info->_function = function;
+
+  // observe object with info
+  [self _observe:object info:info];
+  return info;
+}
+
+- (void)setContext:(nullable void *)context forObservation:(id)observation
+{
+  NSAssert([observation isKindOfClass:[_FBKVOInfo class]], @"invalid observation:%@", observation);
+  if (![observation isKindOfClass:[_FBKVOInfo class]]) {
+    return;
+  }
+
+  ((_FBKVOInfo *)observation)->_context = context;
+}
+
 - (void)observe:(nullable id)object keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options action:(SEL)action
 {
   [self observe:object keyPath:keyPath options:options action:action queue:NULL];
@@ -691,6 +4056,92 @@ typedef NS_ENUM(uint8_t, _FBKVOInfoState) {
   }
 }
 
+- (void)observe:(nullable id)object collectionKeyPath:(NSString *)collectionKeyPath elementKeyPath:(NSString *)elementKeyPath block:(FBKVOAggregateBlock)block
+{
+  NSAssert(0 != collectionKeyPath.length && 0 != elementKeyPath.length && NULL != block, @"missing required parameters observe:%@ collectionKeyPath:%@ elementKeyPath:%@ block:%p", object, collectionKeyPath, elementKeyPath, block);
+  if (nil == object || 0 == collectionKeyPath.length || 0 == elementKeyPath.length || NULL == block) {
+    return;
+  }
+
+  // the tracker lives as long as the collection observation
+  _FBKVOAggregateTracker *tracker = [[_FBKVOAggregateTracker alloc] initWithController:self object:object elementKeyPath:elementKeyPath block:block];
+
+  NSKeyValueObservingOptions options = NSKeyValueObservingOptionInitial|NSKeyValueObservingOptionOld|NSKeyValueObservingOptionNew;
+  [self observe:object keyPath:collectionKeyPath options:options block:^(id observer, id collectionOwner, NSDictionary<NSString *, id> *change) {
+    [tracker applyCollectionChange:change];
+  }];
+}
+
+- (void)combineLatest:(NSArray *)objects keyPaths:(NSArray<NSString *> *)keyPaths queue:(nullable dispatch_queue_t)queue block:(FBKVOCombineLatestBlock)block
+{
+  NSAssert(0 != objects.count && objects.count == keyPaths.count && NULL != block, @"missing required parameters combineLatest:%@ keyPaths:%@ block:%p", objects, keyPaths, block);
+  if (0 == objects.count || objects.count != keyPaths.count || NULL == block) {
+    return;
+  }
+
+  _FBKVOCombiner *combiner = [[_FBKVOCombiner alloc] initWithController:self objects:objects keyPaths:keyPaths queue:queue ?: self.defaultQueue ?: dispatch_get_main_queue() block:block];
+
+  [objects enumerateObjectsUsingBlock:^(id object, NSUInteger idx, BOOL *stop) {
+    _FBKVOInfo *info = [[_FBKVOInfo alloc] initWithController:self keyPath:keyPaths[idx] options:NSKeyValueObservingOptionInitial|NSKeyValueObservingOptionNew block:^(id observer, id changedObject, NSDictionary<NSString *, id> *change) {
+      id value = change[NSKeyValueChangeNewKey];
+      [combiner setValue:(value == [NSNull null] ? nil : value) atIndex:idx];
+    } action:NULL queue:NULL context:NULL];
+    info->_group = combiner;
+    [self _observe:object info:info];
+  }];
+}
+
+- (void)bind:(nullable id)source keyPath:(NSString *)sourceKeyPath toTarget:(id)target keyPath:(NSString *)targetKeyPath
+{
+  [self bind:source keyPath:sourceKeyPath toTarget:target keyPath:targetKeyPath transform:NULL];
+}
+
+- (void)bind:(nullable id)source keyPath:(NSString *)sourceKeyPath toTarget:(id)target keyPath:(NSString *)targetKeyPath transform:(nullable FBKVOBindingTransform)transform
+{
+  NSAssert(0 != sourceKeyPath.length && nil != target && 0 != targetKeyPath.length, @"missing required parameters bind:%@ keyPath:%@ toTarget:%@ keyPath:%@", source, sourceKeyPath, target, targetKeyPath);
+  if (nil == source || 0 == sourceKeyPath.length || nil == target || 0 == targetKeyPath.length) {
+    return;
+  }
+
+  _FBKVOBinding *binding = [[_FBKVOBinding alloc] initWithTarget:target sourceKeyPath:sourceKeyPath targetKeyPath:targetKeyPath transform:transform];
+  [binding resolveSource:source target:target];
+
+  // values are read from the source directly, so the change dictionary need not carry them
+  _FBKVOInfo *info = [[_FBKVOInfo alloc] initWithController:self keyPath:sourceKeyPath options:NSKeyValueObservingOptionInitial context:NULL];
+  info->_binding = binding;
+
+  [self _observe:source info:info];
+}
+
+- (void)bind:(nullable id)object keyPath:(NSString *)keyPath twoWayToTarget:(id)target keyPath:(NSString *)targetKeyPath
+{
+  NSAssert(0 != keyPath.length && nil != target && 0 != targetKeyPath.length, @"missing required parameters bind:%@ keyPath:%@ twoWayToTarget:%@ keyPath:%@", object, keyPath, target, targetKeyPath);
+  if (nil == object || 0 == keyPath.length || nil == target || 0 == targetKeyPath.length) {
+    return;
+  }
+
+  _FBKVOBindingGuard *guard = [[_FBKVOBindingGuard alloc] init];
+
+  _FBKVOBinding *forward = [[_FBKVOBinding alloc] initWithTarget:target sourceKeyPath:keyPath targetKeyPath:targetKeyPath transform:NULL];
+  forward->_compares = YES;
+  forward->_guard = guard;
+  [forward resolveSource:object target:target];
+
+  _FBKVOBinding *backward = [[_FBKVOBinding alloc] initWithTarget:object sourceKeyPath:targetKeyPath targetKeyPath:keyPath transform:NULL];
+  backward->_compares = YES;
+  backward->_guard = guard;
+  [backward resolveSource:target target:object];
+
+  // the object value initially wins
+  _FBKVOInfo *forwardInfo = [[_FBKVOInfo alloc] initWithController:self keyPath:keyPath options:NSKeyValueObservingOptionInitial context:NULL];
+  forwardInfo->_binding = forward;
+  _FBKVOInfo *backwardInfo = [[_FBKVOInfo alloc] initWithController:self keyPath:targetKeyPath options:0 context:NULL];
+  backwardInfo->_binding = backward;
+
+  [self _observe:object info:forwardInfo];
+  [self _observe:target info:backwardInfo];
+}
+
 - (void)unobserve:(nullable id)object keyPath:(NSString *)keyPath
 {
   // create representative info
@@ -700,6 +4151,16 @@ typedef NS_ENUM(uint8_t, _FBKVOInfoState) {
   [self _unobserve:object info:info];
 }
 
+- (void)unobserve:(nullable id)object observation:(nullable id)observation
+{
+  if (nil == object || ![observation isKindOfClass:[_FBKVOInfo class]]) {
+    return;
+  }
+
+  // unobserve object property
+  [self _unobserve:object info:observation];
+}
+
 - (void)unobserve:(nullable id)object
 {
   if (nil == object) {
@@ -709,6 +4170,78 @@ typedef NS_ENUM(uint8_t, _FBKVOInfoState) {
   [self _unobserve:object];
 }
 
+- (nullable FBKVOStream *)streamForObject:(nullable id)object keyPath:(NSString *)keyPath capacity:(NSUInteger)capacity
+{
+  NSAssert(0 != keyPath.length && 0 != capacity, @"missing required parameters streamForObject:%@ keyPath:%@ capacity:%lu", object, keyPath, (unsigned long)capacity);
+  if (nil == object || 0 == keyPath.length || 0 == capacity) {
+    return nil;
+  }
+
+  FBKVOStream *stream = [[FBKVOStream alloc] initWithCapacity:capacity controller:self object:object keyPath:keyPath];
+
+  // create info, buffering changes synchronously rather than delivering them
+  _FBKVOInfo *info = [[_FBKVOInfo alloc] initWithController:self keyPath:keyPath options:NSKeyValueObservingOptionOld|NSKeyValueObservingOptionNew block:NULL action:NULL queue:NULL context:NULL];
+  info->_stream = stream;
+
+  // observe object with info, unless already observed
+  [self _observe:object info:info];
+  return info == [self _registeredInfo:info object:object] ? stream : nil;
+}
+
+- (void)observeOnce:(nullable id)object keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options block:(FBKVONotificationBlock)block
+{
+  [self observe:object keyPath:keyPath options:options count:1 block:block];
+}
+
+- (void)observe:(nullable id)object keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options count:(NSUInteger)count block:(FBKVONotificationBlock)block
+{
+  NSAssert(0 != keyPath.length && 0 != count && NULL != block, @"missing required parameters observe:%@ keyPath:%@ count:%lu block:%p", object, keyPath, (unsigned long)count, block);
+  if (nil == object || 0 == keyPath.length || 0 == count || NULL == block) {
+    return;
+  }
+
+  // create info, counting down deliveries
+  _FBKVOInfo *info = [[_FBKVOInfo alloc] initWithController:self keyPath:keyPath options:options block:block];
+  info->_limited = YES;
+  atomic_init(&info->_remaining, count);
+
+  // observe object with info
+  [self _observe:object info:info];
+}
+
+- (void)observeAsync:(nullable id)object keyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options block:(FBKVONotificationBlock)block
+{
+  NSAssert(0 != keyPath.length && NULL != block, @"missing required parameters observe:%@ keyPath:%@ block:%p", object, keyPath, block);
+  if (nil == object || 0 == keyPath.length || NULL == block) {
+    return;
+  }
+
+  // create info, registered with Foundation on the registration lane of object
+  _FBKVOInfo *info = [[_FBKVOInfo alloc] initWithController:self keyPath:keyPath options:options block:block];
+  info->_async = YES;
+
+  // observe object with info
+  [self _observe:object info:info];
+}
+
+- (void)unobserveAsync:(nullable id)object keyPath:(NSString *)keyPath
+{
+  // create representative info
+  _FBKVOInfo *info = [[_FBKVOInfo alloc] initWithController:self keyPath:keyPath];
+
+  // unobserve object property
+  [self _unobserve:object info:info async:YES];
+}
+
+- (void)unobserveAsync:(nullable id)object
+{
+  if (nil == object) {
+    return;
+  }
+
+  [self _unobserve:object async:YES];
+}
+
 - (void)unobserveAll
 {
   [self _unobserveAll];
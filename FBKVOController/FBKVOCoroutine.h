@@ -0,0 +1,228 @@
+/**
+ Copyright (c) 2014-present, Facebook, Inc.
+ All rights reserved.
+
+ This source code is licensed under the BSD-style license found in the
+ LICENSE file in the root directory of this source tree. An additional grant
+ of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#import <Foundation/Foundation.h>
+
+#import "FBKVOController.h"
+
+#if defined(__cplusplus) && defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace FBKVO {
+
+namespace detail {
+
+/**
+ @abstract Changes pending for a single consumer, and the coroutine awaiting the next one.
+ */
+struct ChangeState {
+  std::mutex mutex;
+  std::deque<FBKVOChange *> pending;
+  std::coroutine_handle<> waiter;
+  FBKVOChange *result = nil;
+  bool cancelled = false;
+
+  void push(FBKVOChange *change)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (cancelled) {
+      return;
+    }
+    if (!waiter) {
+      pending.push_back(change);
+      return;
+    }
+    // hand over to the waiting coroutine, resuming it on this thread
+    std::coroutine_handle<> handle = std::exchange(waiter, nullptr);
+    result = change;
+    lock.unlock();
+    handle.resume();
+  }
+
+  void cancel()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cancelled = true;
+    pending.clear();
+    std::coroutine_handle<> handle = std::exchange(waiter, nullptr);
+    lock.unlock();
+    if (handle) {
+      handle.resume();
+    }
+  }
+};
+
+} // namespace detail
+
+/**
+ @abstract Awaits the next change of a sequence. Resumes with nil once the sequence is cancelled.
+ */
+class ChangeAwaitable {
+public:
+  explicit ChangeAwaitable(std::shared_ptr<detail::ChangeState> state) : _state(std::move(state)) {}
+
+  bool await_ready() const noexcept
+  {
+    return false;
+  }
+
+  bool await_suspend(std::coroutine_handle<> handle)
+  {
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    if (!_state->pending.empty()) {
+      _change = _state->pending.front();
+      _state->pending.pop_front();
+      return false;
+    }
+    if (_state->cancelled) {
+      return false;
+    }
+    // resumed by the change, do not touch the awaitable past this point
+    _state->waiter = handle;
+    return true;
+  }
+
+  FBKVOChange *await_resume()
+  {
+    if (nil != _change) {
+      return _change;
+    }
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    return std::exchange(_state->result, nil);
+  }
+
+private:
+  std::shared_ptr<detail::ChangeState> _state;
+  FBKVOChange *_change = nil;
+};
+
+/**
+ @abstract An asynchronous sequence of changes to an object key path, for a single consuming coroutine.
+ @discussion Observes from construction until cancelled or destroyed, buffering changes not yet awaited. Iterate with:
+
+ while (FBKVOChange *change = co_await sequence.next()) { ... }
+ */
+class ChangeSequence {
+public:
+  ChangeSequence(id object, NSString *keyPath, id<FBKVOExecutor> executor = nil)
+  : _token([[NSObject alloc] init]), _state(std::make_shared<detail::ChangeState>())
+  {
+    _controller = [[FBKVOController alloc] initWithObserver:_token];
+    _controller.defaultQueue = NULL;
+
+    // resume directly from the delivery, on the thread of the change or within the executor's block
+    std::shared_ptr<detail::ChangeState> state = _state;
+    FBKVONotificationBlock block = ^(id observer, id changedObject, NSDictionary<NSString *, id> *change) {
+      state->push([[FBKVOChange alloc] initWithObject:changedObject change:change]);
+    };
+    NSKeyValueObservingOptions options = NSKeyValueObservingOptionOld | NSKeyValueObservingOptionNew;
+    if (nil != executor) {
+      [_controller observe:object keyPath:keyPath options:options executor:executor block:block];
+    } else {
+      [_controller observe:object keyPath:keyPath options:options block:block];
+    }
+  }
+
+  ChangeSequence(ChangeSequence &&other) noexcept
+  : _token(other._token), _controller(other._controller), _state(std::move(other._state))
+  {
+    other._token = nil;
+    other._controller = nil;
+  }
+
+  ChangeSequence &operator=(ChangeSequence &&other) noexcept
+  {
+    if (this != &other) {
+      cancel();
+      _token = other._token;
+      _controller = other._controller;
+      _state = std::move(other._state);
+      other._token = nil;
+      other._controller = nil;
+    }
+    return *this;
+  }
+
+  ChangeSequence(const ChangeSequence &) = delete;
+  ChangeSequence &operator=(const ChangeSequence &) = delete;
+
+  ~ChangeSequence()
+  {
+    cancel();
+  }
+
+  /**
+   @abstract Returns an awaitable of the next change, nil once cancelled.
+   */
+  ChangeAwaitable next() const
+  {
+    return ChangeAwaitable(_state);
+  }
+
+  /**
+   @abstract Stops observing, resuming an awaiting coroutine with nil.
+   @discussion May be called, or the sequence destroyed, by a coroutine resumed from the sequence's own delivery.
+   */
+  void cancel()
+  {
+    // drop further changes first, in case unobserving races a delivery
+    if (_state) {
+      _state->cancel();
+    }
+    [_controller unobserveAll];
+    _controller = nil;
+  }
+
+private:
+  // the controller's observer
+  NSObject *_token;
+  FBKVOController *_controller;
+  std::shared_ptr<detail::ChangeState> _state;
+};
+
+/**
+ @abstract Creates change sequences resuming on an executor.
+ @discussion Awaiting a single change is done through a sequence too, which observes once for all the changes it awaits:
+
+ FBKVO::ChangeSequence sequence = FBKVO::Changes().changes(object, @"state");
+ FBKVOChange *change = co_await sequence.next();
+ */
+class Changes {
+public:
+  /**
+   @param executor The executor running resumptions. If nil, coroutines resume synchronously on the thread of the change.
+   */
+  explicit Changes(id<FBKVOExecutor> executor = nil) : _executor(executor) {}
+
+  /**
+   @abstract Returns a sequence of the changes of object key path.
+   @discussion Observation starts when called, so a change made before awaiting is not missed.
+   */
+  ChangeSequence changes(id object, NSString *keyPath) const
+  {
+    return ChangeSequence(object, keyPath, _executor);
+  }
+
+  ChangeSequence changes(id object, const char *keyPath) const
+  {
+    return changes(object, @(keyPath));
+  }
+
+private:
+  id<FBKVOExecutor> _executor;
+};
+
+} // namespace FBKVO
+
+#endif
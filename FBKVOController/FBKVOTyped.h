@@ -0,0 +1,358 @@
+/**
+ Copyright (c) 2014-present, Facebook, Inc.
+ All rights reserved.
+
+ This source code is licensed under the BSD-style license found in the
+ LICENSE file in the root directory of this source tree. An additional grant
+ of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#import <Foundation/Foundation.h>
+
+#import "FBKVOController.h"
+
+#ifdef __cplusplus
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ This macro creates a typed property descriptor, for use with FBKVO::observe.
+ Given a receiver type and a key path, it verifies at compile time that the key path exists, and captures the type of its value.
+
+ For example:
+
+ FBKVOProperty(NSString, length) => FBKVO::Property<NSString, NSUInteger>(@"length")
+ */
+#define FBKVOProperty(CLASS, KEYPATH) \
+(::FBKVO::Property<CLASS, ::FBKVO::detail::value_t<decltype(((CLASS *)(nil)).KEYPATH)>>(FBKVOClassKeyPath(CLASS, KEYPATH)))
+
+namespace FBKVO {
+
+/**
+ @abstract A key path of Object, with values of type Value.
+ @discussion Create with the FBKVOProperty macro.
+ */
+template <typename Object, typename Value>
+struct Property {
+  explicit Property(NSString *keyPath) : keyPath(keyPath) {}
+
+  NSString *keyPath;
+};
+
+namespace detail {
+
+template <typename T>
+using value_t = typename std::remove_cv<typename std::remove_reference<T>::type>::type;
+
+template <typename T>
+struct identity {
+  using type = T;
+};
+
+/**
+ @abstract Whether Callable can be called with Args.
+ */
+template <typename Callable, typename... Args>
+struct is_invocable {
+  template <typename C>
+  static auto test(int) -> decltype(std::declval<C &>()(std::declval<Args>()...), std::true_type());
+
+  template <typename C>
+  static std::false_type test(...);
+
+  static constexpr bool value = decltype(test<Callable>(0))::value;
+};
+
+/**
+ @abstract Unboxes change values. Structures are read from NSValue, if of the same type.
+ */
+template <typename T, typename Enable = void>
+struct Unbox {
+  static_assert(std::is_trivially_copyable<T>::value, "unsupported property type");
+
+  static T get(id value)
+  {
+    T result{};
+    if ([value isKindOfClass:[NSValue class]] && 0 == strcmp([(NSValue *)value objCType], @encode(T))) {
+      [(NSValue *)value getValue:&result];
+    }
+    return result;
+  }
+};
+
+template <typename T>
+struct Unbox<T, typename std::enable_if<std::is_same<T, bool>::value>::type> {
+  static T get(id value)
+  {
+    return [value isKindOfClass:[NSNumber class]] ? [(NSNumber *)value boolValue] : false;
+  }
+};
+
+template <typename T>
+struct Unbox<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+  static T get(id value)
+  {
+    return [value isKindOfClass:[NSNumber class]] ? static_cast<T>([(NSNumber *)value doubleValue]) : T();
+  }
+};
+
+template <typename T>
+struct Unbox<T, typename std::enable_if<(std::is_integral<T>::value && !std::is_same<T, bool>::value) || std::is_enum<T>::value>::type> {
+  static T get(id value)
+  {
+    if (![value isKindOfClass:[NSNumber class]]) {
+      return T();
+    }
+    return std::is_signed<T>::value ? static_cast<T>([(NSNumber *)value longLongValue]) : static_cast<T>([(NSNumber *)value unsignedLongLongValue]);
+  }
+};
+
+template <typename T>
+struct Unbox<T, typename std::enable_if<std::is_pointer<T>::value && std::is_convertible<T, id>::value>::type> {
+  static T get(id value)
+  {
+    return [NSNull null] == value ? nil : (T)value;
+  }
+};
+
+// targets up to this size, an observer reference and a callable of three pointers, are stored inline in the observation
+static const std::size_t InlineSize = 4 * sizeof(void *);
+
+typedef std::aligned_storage<InlineSize, alignof(std::max_align_t)>::type Storage;
+
+/**
+ @abstract The observer and callable of an observation, called by the controller with a pointer to them as context.
+ */
+template <typename Observer, typename Object, typename Value, typename Callable>
+struct Target {
+  Observer &observer;
+  Callable callable;
+
+  static void notify(void *context, id object, NSDictionary<NSString *, id> *change)
+  {
+    Target *target = static_cast<Target *>(context);
+    target->callable(target->observer, (Object *)object, Unbox<Value>::get(change[NSKeyValueChangeOldKey]), Unbox<Value>::get(change[NSKeyValueChangeNewKey]));
+  }
+};
+
+/**
+ @abstract Type-erased operations on a target in storage. Moving returns the context of the moved target.
+ */
+struct Operations {
+  void *(*move)(Storage &from, Storage &to);
+  void (*destroy)(Storage &storage);
+};
+
+template <typename T, bool Inline = (sizeof(T) <= sizeof(Storage) && alignof(T) <= alignof(Storage) && std::is_nothrow_move_constructible<T>::value)>
+struct Store;
+
+template <typename T>
+struct Store<T, true> {
+  static void *create(Storage &storage, T &&target)
+  {
+    return new (&storage) T(std::move(target));
+  }
+
+  static void *move(Storage &from, Storage &to)
+  {
+    T *source = reinterpret_cast<T *>(&from);
+    T *destination = new (&to) T(std::move(*source));
+    source->~T();
+    return destination;
+  }
+
+  static void destroy(Storage &storage)
+  {
+    reinterpret_cast<T *>(&storage)->~T();
+  }
+
+  static const Operations operations;
+};
+
+template <typename T>
+struct Store<T, false> {
+  static void *create(Storage &storage, T &&target)
+  {
+    T *pointer = new T(std::move(target));
+    *reinterpret_cast<T **>(&storage) = pointer;
+    return pointer;
+  }
+
+  static void *move(Storage &from, Storage &to)
+  {
+    T *pointer = *reinterpret_cast<T **>(&from);
+    *reinterpret_cast<T **>(&to) = pointer;
+    return pointer;
+  }
+
+  static void destroy(Storage &storage)
+  {
+    delete *reinterpret_cast<T **>(&storage);
+  }
+
+  static const Operations operations;
+};
+
+template <typename T>
+const Operations Store<T, true>::operations = {&Store<T, true>::move, &Store<T, true>::destroy};
+
+template <typename T>
+const Operations Store<T, false>::operations = {&Store<T, false>::move, &Store<T, false>::destroy};
+
+/**
+ @abstract The controller of observations created without one, delivering synchronously.
+ */
+inline FBKVOController *shared_controller()
+{
+  // observations retain their object, and need no observer
+  static FBKVOController *controller = [] {
+    FBKVOController *sharedController = [[FBKVOController alloc] initWithObserver:nil retainObserved:NO];
+    sharedController.defaultQueue = NULL;
+    return sharedController;
+  }();
+  return controller;
+}
+
+} // namespace detail
+
+class Observation;
+
+template <typename Observer, typename Object, typename Value, typename Callable>
+Observation observe(FBKVOController *controller, Observer &observer, typename detail::identity<Object>::type *object, const Property<Object, Value> &property, Callable callable, NSKeyValueObservingOptions options = 0);
+
+/**
+ @abstract Handle of a typed observation, cancelling it on destruction.
+ @discussion Move-only. Small callables are stored inline in the handle, and moved with it. Destroy or move the handle before its observer, and not concurrently with changes to the observed object.
+ */
+class Observation {
+public:
+  Observation() = default;
+
+  Observation(Observation &&other) noexcept
+  {
+    take(other);
+  }
+
+  Observation &operator=(Observation &&other) noexcept
+  {
+    if (this != &other) {
+      cancel();
+      take(other);
+    }
+    return *this;
+  }
+
+  Observation(const Observation &) = delete;
+  Observation &operator=(const Observation &) = delete;
+
+  ~Observation()
+  {
+    cancel();
+  }
+
+  /**
+   @abstract Stops observing. Subsequent calls result in no operation.
+   */
+  void cancel()
+  {
+    if (nullptr == _operations) {
+      return;
+    }
+    [_controller unobserve:_object observation:_observation];
+    _operations->destroy(_storage);
+    _operations = nullptr;
+    _controller = nil;
+    _object = nil;
+    _observation = nil;
+  }
+
+  /**
+   @abstract Whether the handle holds an observation.
+   */
+  explicit operator bool() const
+  {
+    return nullptr != _operations;
+  }
+
+private:
+  template <typename Observer, typename Object, typename Value, typename Callable>
+  friend Observation observe(FBKVOController *controller, Observer &observer, typename detail::identity<Object>::type *object, const Property<Object, Value> &property, Callable callable, NSKeyValueObservingOptions options);
+
+  void take(Observation &other) noexcept
+  {
+    if (nullptr == other._operations) {
+      return;
+    }
+    // inline targets move, so the observation is pointed at the new context
+    void *context = other._operations->move(other._storage, _storage);
+    [other._controller setContext:context forObservation:other._observation];
+    _operations = other._operations;
+    _controller = other._controller;
+    _object = other._object;
+    _observation = other._observation;
+    other._operations = nullptr;
+    other._controller = nil;
+    other._object = nil;
+    other._observation = nil;
+  }
+
+  const detail::Operations *_operations = nullptr;
+  FBKVOController *_controller = nil;
+  id _object = nil;
+  id _observation = nil;
+  detail::Storage _storage;
+};
+
+/**
+ @abstract Observes a property with a typed callable.
+ @param controller The controller holding the observation, which may hold any number of typed observations.
+ @param observer The observer, passed to the callable by reference.
+ @param object The object to observe, retained while observing.
+ @param property The property to observe, created with the FBKVOProperty macro.
+ @param callable The callable, invoked as callable(observer, object, oldValue, newValue) with unboxed values of the property type. Checked at compile time.
+ @param options NSKeyValueObservingOptionInitial, or 0. Old and new values are always observed, prior notifications never.
+ @return The observation handle.
+ @discussion The callable is called synchronously on the thread of the change through a function observation of the controller, so no block or std::function is allocated. Callables of up to three pointers are stored inline in the handle, larger ones on the heap.
+ */
+template <typename Observer, typename Object, typename Value, typename Callable>
+Observation observe(FBKVOController *controller, Observer &observer, typename detail::identity<Object>::type *object, const Property<Object, Value> &property, Callable callable, NSKeyValueObservingOptions options)
+{
+  static_assert(detail::is_invocable<Callable, Observer &, Object *, Value, Value>::value,
+                "callable must be invocable as (Observer &, Object *, Value oldValue, Value newValue), Value being the property type");
+  typedef detail::Target<Observer, Object, Value, Callable> Target;
+  typedef detail::Store<Target> Store;
+
+  Observation observation;
+  if (nil == controller || nil == object) {
+    return observation;
+  }
+
+  void *context = Store::create(observation._storage, Target{observer, std::move(callable)});
+  options = (options & NSKeyValueObservingOptionInitial) | NSKeyValueObservingOptionOld | NSKeyValueObservingOptionNew;
+  observation._operations = &Store::operations;
+  observation._controller = controller;
+  observation._object = object;
+  observation._observation = [controller observe:object keyPath:property.keyPath options:options function:&Target::notify context:context];
+  if (nil == observation._observation) {
+    observation.cancel();
+  }
+  return observation;
+}
+
+/**
+ @abstract Observes a property with a typed callable, on a shared controller.
+ @discussion See the observe overload taking a controller.
+ */
+template <typename Observer, typename Object, typename Value, typename Callable>
+Observation observe(Observer &observer, typename detail::identity<Object>::type *object, const Property<Object, Value> &property, Callable callable, NSKeyValueObservingOptions options = 0)
+{
+  return observe(detail::shared_controller(), observer, object, property, std::move(callable), options);
+}
+
+} // namespace FBKVO
+
+#endif
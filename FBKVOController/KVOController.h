@@ -9,3 +9,7 @@
 
 #import <KVOController/FBKVOController.h>
 #import <KVOController/NSObject+FBKVOController.h>
+
+// Objective-C++ only, empty otherwise
+#import <KVOController/FBKVOTyped.h>
+#import <KVOController/FBKVOCoroutine.h>
@@ -497,6 +497,893 @@ static NSKeyValueObservingOptions const optionsAll = optionsBasic | NSKeyValueOb
   circle.radius = 1.0;
 }
 
+- (void)testObserveCollectionAggregateIncrementally
+{
+  FBKVOTestCircle *circle1 = [FBKVOTestCircle circle];
+  FBKVOTestCircle *circle2 = [FBKVOTestCircle circle];
+  FBKVOTestCircle *circle3 = [FBKVOTestCircle circle];
+  circle1.radius = 1.0;
+  circle2.radius = 2.0;
+  circle3.radius = 4.0;
+
+  FBKVOTestCanvas *canvas = [FBKVOTestCanvas canvas];
+  canvas.circles = @[circle1, circle2];
+
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+
+  __block NSUInteger blockCallCount = 0;
+  __block FBKVOAggregate *blockAggregate = nil;
+  [controller observe:canvas collectionKeyPath:@"circles" elementKeyPath:radius block:^(id observer, id object, FBKVOAggregate *aggregate) {
+    blockAggregate = aggregate;
+    blockCallCount++;
+  }];
+
+  // verify initial
+  XCTAssert(1 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 1);
+  XCTAssertEqual(blockAggregate.count, 2u);
+  XCTAssertEqualWithAccuracy(blockAggregate.sum, 3.0, 0.0001);
+  XCTAssertEqualObjects(blockAggregate.minimum, @1.0);
+  XCTAssertEqualObjects(blockAggregate.maximum, @2.0);
+
+  // element change
+  circle1.radius = 3.0;
+  XCTAssert(2 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 2);
+  XCTAssertEqualWithAccuracy(blockAggregate.sum, 5.0, 0.0001);
+  XCTAssertEqualWithAccuracy(blockAggregate.average, 2.5, 0.0001);
+  XCTAssertEqualObjects(blockAggregate.minimum, @2.0);
+  XCTAssertEqualObjects(blockAggregate.maximum, @3.0);
+
+  // insertion
+  [[canvas mutableArrayValueForKey:@"circles"] addObject:circle3];
+  XCTAssertEqual(blockAggregate.count, 3u);
+  XCTAssertEqualWithAccuracy(blockAggregate.sum, 9.0, 0.0001);
+  XCTAssertEqualObjects(blockAggregate.maximum, @4.0);
+
+  // removal
+  [[canvas mutableArrayValueForKey:@"circles"] removeObjectAtIndex:2];
+  XCTAssertEqual(blockAggregate.count, 2u);
+  XCTAssertEqualWithAccuracy(blockAggregate.sum, 5.0, 0.0001);
+  XCTAssertEqualObjects(blockAggregate.maximum, @3.0);
+
+  // removed elements no longer contribute
+  NSUInteger callCount = blockCallCount;
+  circle3.radius = 10.0;
+  XCTAssert(callCount == blockCallCount, @"unexpected block call count:%lu expected:%lu", (unsigned long)blockCallCount, (unsigned long)callCount);
+
+  // unobserve
+  [controller unobserve:canvas keyPath:@"circles"];
+  circle1.radius = 0.0;
+  XCTAssert(callCount == blockCallCount, @"unexpected block call count:%lu expected:%lu", (unsigned long)blockCallCount, (unsigned long)callCount);
+}
+
+- (void)testComputedEvaluatesLazilyAndNotifiesOnlyOnChange
+{
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  __block NSUInteger evaluationCount = 0;
+
+  FBKVOComputed *isLarge = [FBKVOComputed computedWithBlock:^id(FBKVOComputed *computed) {
+    evaluationCount++;
+    return @([[computed valueForObject:circle keyPath:radius] floatValue] > 1.0);
+  }];
+  XCTAssert(1 == evaluationCount, @"unexpected evaluation count:%lu expected:%d", (unsigned long)evaluationCount, 1);
+  XCTAssertEqualObjects(isLarge.value, @NO);
+
+  // unobserved computed is marked stale, and evaluated on read
+  circle.radius = 0.5;
+  circle.radius = 0.75;
+  XCTAssert(1 == evaluationCount, @"unexpected evaluation count:%lu expected:%d", (unsigned long)evaluationCount, 1);
+  XCTAssertEqualObjects(isLarge.value, @NO);
+  XCTAssert(2 == evaluationCount, @"unexpected evaluation count:%lu expected:%d", (unsigned long)evaluationCount, 2);
+
+  // dependent computed
+  FBKVOComputed *label = [FBKVOComputed computedWithBlock:^id(FBKVOComputed *computed) {
+    return [[computed valueForObject:isLarge keyPath:@"value"] boolValue] ? @"large" : @"small";
+  }];
+
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+  __block NSUInteger blockCallCount = 0;
+  __block NSDictionary *blockChange = nil;
+  [controller observe:label keyPath:@"value" options:NSKeyValueObservingOptionOld|NSKeyValueObservingOptionNew block:^(id observer, id object, NSDictionary *change) {
+    blockChange = change;
+    blockCallCount++;
+  }];
+
+  // result unchanged, no notification
+  circle.radius = 0.9;
+  XCTAssert(0 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 0);
+
+  // result changed
+  circle.radius = 2.0;
+  XCTAssert(1 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 1);
+  XCTAssertEqualObjects(blockChange[NSKeyValueChangeOldKey], @"small");
+  XCTAssertEqualObjects(blockChange[NSKeyValueChangeNewKey], @"large");
+  XCTAssertEqualObjects(label.value, @"large");
+}
+
+- (void)testCombineLatestCoalescesPerQueueTurn
+{
+  FBKVOTestCircle *circle1 = [FBKVOTestCircle circle];
+  FBKVOTestCircle *circle2 = [FBKVOTestCircle circle];
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+
+  __block NSUInteger blockCallCount = 0;
+  __block FBKVOSnapshot *blockSnapshot = nil;
+  [controller combineLatest:@[circle1, circle2] keyPaths:@[radius, borderWidth] queue:nil block:^(id observer, FBKVOSnapshot *snapshot) {
+    blockSnapshot = snapshot;
+    blockCallCount++;
+  }];
+
+  // several changes within the same turn
+  circle1.radius = 1.0;
+  circle2.borderWidth = 2.0;
+  circle1.radius = 3.0;
+  XCTAssert(0 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 0);
+
+  XCTestExpectation *expectation = [self expectationWithDescription:@"delivery"];
+  dispatch_async(dispatch_get_main_queue(), ^{
+    [expectation fulfill];
+  });
+  [self waitForExpectationsWithTimeout:1.0 handler:nil];
+
+  XCTAssert(1 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 1);
+  XCTAssertEqual(blockSnapshot.count, 2u);
+  XCTAssertEqualObjects(blockSnapshot[0], @3.0);
+  XCTAssertEqualObjects([blockSnapshot valueForObject:circle2 keyPath:borderWidth], @2.0);
+}
+
+- (void)testTransactionCoalescesNotificationsUntilCommit
+{
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+
+  NSMutableArray *keyPaths = [NSMutableArray array];
+  __block NSDictionary *radiusChange = nil;
+  [controller observe:circle keyPath:radius options:NSKeyValueObservingOptionOld|NSKeyValueObservingOptionNew block:^(id observer, id object, NSDictionary *change) {
+    radiusChange = change;
+    [keyPaths addObject:radius];
+  }];
+  [controller observe:circle keyPath:borderWidth options:NSKeyValueObservingOptionNew block:^(id observer, id object, NSDictionary *change) {
+    [keyPaths addObject:borderWidth];
+  }];
+
+  [FBKVOController beginTransaction];
+  circle.borderWidth = 1.0;
+  circle.radius = 1.0;
+  circle.radius = 2.0;
+  circle.radius = 3.0;
+  XCTAssertEqual(keyPaths.count, 0u);
+  [FBKVOController commit];
+
+  // delivered once each, in registration order
+  NSArray *expectedKeyPaths = @[radius, borderWidth];
+  XCTAssertEqualObjects(keyPaths, expectedKeyPaths);
+  XCTAssertEqualObjects(radiusChange[NSKeyValueChangeOldKey], @0.0);
+  XCTAssertEqualObjects(radiusChange[NSKeyValueChangeNewKey], @3.0);
+
+  // delivered immediately outside a transaction
+  circle.radius = 4.0;
+  XCTAssertEqual(keyPaths.count, 3u);
+}
+
+- (void)testMaximumNotificationDepthDefersCascadesAndReportsCycles
+{
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+
+  __block NSArray *cycleKeyPaths = nil;
+  [FBKVOController setNotificationCycleHandler:^(NSArray<NSString *> *keyPaths) {
+    cycleKeyPaths = keyPaths;
+  }];
+  [FBKVOController setMaximumNotificationDepth:1];
+
+  __block NSUInteger depth = 0;
+  __block NSUInteger maximumDepth = 0;
+  __block NSUInteger blockCallCount = 0;
+  [controller observe:circle keyPath:radius options:NSKeyValueObservingOptionNew block:^(id observer, FBKVOTestCircle *object, NSDictionary *change) {
+    depth++;
+    maximumDepth = MAX(maximumDepth, depth);
+    blockCallCount++;
+    if (object.radius < 5.0) {
+      object.radius = object.radius + 1.0;
+    }
+    depth--;
+  }];
+
+  circle.radius = 1.0;
+
+  // cascade delivered iteratively rather than recursively
+  XCTAssert(5 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 5);
+  XCTAssert(1 == maximumDepth, @"unexpected depth:%lu expected:%d", (unsigned long)maximumDepth, 1);
+  NSArray *expectedKeyPaths = @[radius, radius];
+  XCTAssertEqualObjects(cycleKeyPaths, expectedKeyPaths);
+
+  // cleanup
+  [FBKVOController setMaximumNotificationDepth:NSUIntegerMax];
+  [FBKVOController setNotificationCycleHandler:nil];
+}
+
+- (void)testBindCopiesSourceValueToTarget
+{
+  FBKVOTestCircle *source = [FBKVOTestCircle circle];
+  FBKVOTestCircle *target = [FBKVOTestCircle circle];
+  FBKVOController *controller = [FBKVOController controllerWithObserver:nil];
+  source.radius = 1.0;
+
+  [controller bind:source keyPath:radius toTarget:target keyPath:borderWidth];
+
+  // verify initial
+  XCTAssertEqual(target.borderWidth, 1.0f);
+
+  // verify change
+  source.radius = 2.5;
+  XCTAssertEqual(target.borderWidth, 2.5f);
+
+  // target observers are notified
+  FBKVOTestObserver *referenceObserver = [FBKVOTestObserver observer];
+  [target addObserver:referenceObserver forKeyPath:borderWidth options:NSKeyValueObservingOptionNew context:context];
+  source.radius = 3.0;
+  XCTAssertEqualObjects(referenceObserver.lastChange[NSKeyValueChangeNewKey], @3.0);
+  [target removeObserver:referenceObserver forKeyPath:borderWidth];
+
+  // verify unbind
+  [controller unobserve:source keyPath:radius];
+  source.radius = 4.0;
+  XCTAssertEqual(target.borderWidth, 3.0f);
+}
+
+- (void)testTwoWayBindSuppressesEcho
+{
+  FBKVOTestCircle *circle1 = [FBKVOTestCircle circle];
+  FBKVOTestCircle *circle2 = [FBKVOTestCircle circle];
+  FBKVOController *controller = [FBKVOController controllerWithObserver:nil];
+  circle1.radius = 1.0;
+
+  [controller bind:circle1 keyPath:radius twoWayToTarget:circle2 keyPath:radius];
+  XCTAssertEqual(circle2.radius, 1.0f);
+
+  // count notifications on both ends
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *countingController = [FBKVOController controllerWithObserver:observer];
+  __block NSUInteger circle1Count = 0;
+  __block NSUInteger circle2Count = 0;
+  [countingController observe:circle1 keyPath:radius options:0 block:^(id observer, id object, NSDictionary *change) {
+    circle1Count++;
+  }];
+  [countingController observe:circle2 keyPath:radius options:0 block:^(id observer, id object, NSDictionary *change) {
+    circle2Count++;
+  }];
+
+  circle1.radius = 2.0;
+  XCTAssertEqual(circle2.radius, 2.0f);
+  XCTAssert(1 == circle1Count && 1 == circle2Count, @"unexpected counts:%lu %lu expected:1 1", (unsigned long)circle1Count, (unsigned long)circle2Count);
+
+  circle2.radius = 3.0;
+  XCTAssertEqual(circle1.radius, 3.0f);
+  XCTAssert(2 == circle1Count && 2 == circle2Count, @"unexpected counts:%lu %lu expected:2 2", (unsigned long)circle1Count, (unsigned long)circle2Count);
+}
+
+- (void)testPauseDropsNotificationsUntilResume
+{
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+  [controller observe:circle keyPath:radius options:NSKeyValueObservingOptionNew action:@selector(propertyDidChange)];
+
+  [controller pause];
+  XCTAssertTrue(controller.isPaused);
+  circle.radius = 1.0;
+  [verifyCount(observer, never()) propertyDidChange];
+
+  // dropped notifications are not delivered on resume
+  [controller resume];
+  [verifyCount(observer, never()) propertyDidChange];
+
+  circle.radius = 2.0;
+  [verifyCount(observer, times(1)) propertyDidChange];
+}
+
+- (void)testPauseRetainingLatestDeliversOnResume
+{
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+
+  __block NSUInteger blockCallCount = 0;
+  __block NSDictionary *blockChange = nil;
+  [controller observe:circle keyPath:radius options:NSKeyValueObservingOptionOld|NSKeyValueObservingOptionNew block:^(id observer, id object, NSDictionary *change) {
+    blockChange = change;
+    blockCallCount++;
+  }];
+
+  [controller pause:circle keyPath:radius retainingLatest:YES];
+  circle.radius = 1.0;
+  circle.radius = 2.0;
+  XCTAssert(0 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 0);
+
+  [controller resume:circle keyPath:radius];
+  XCTAssert(1 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 1);
+  XCTAssertEqualObjects(blockChange[NSKeyValueChangeOldKey], @0.0);
+  XCTAssertEqualObjects(blockChange[NSKeyValueChangeNewKey], @2.0);
+}
+
+- (void)testPauseDroppingDiscardsRetainedNotifications
+{
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+  [controller observe:circle keyPath:radius options:NSKeyValueObservingOptionNew action:@selector(propertyDidChange)];
+
+  [controller pauseRetainingLatest:YES];
+  circle.radius = 1.0;
+
+  // switching to drop discards what was retained
+  [controller pauseRetainingLatest:NO];
+  [controller resume];
+  [verifyCount(observer, never()) propertyDidChange];
+}
+
+- (void)testFrameClockSamplesLatestChangePerFrame
+{
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  FBKVOTestFrameClock *clock = [FBKVOTestFrameClock clock];
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+
+  __block NSUInteger blockCallCount = 0;
+  __block NSDictionary *blockChange = nil;
+  [controller observe:circle keyPath:radius options:NSKeyValueObservingOptionNew frameClock:clock block:^(id observer, id object, NSDictionary *change) {
+    blockChange = change;
+    blockCallCount++;
+  }];
+
+  circle.radius = 1.0;
+  circle.radius = 2.0;
+  circle.radius = 3.0;
+  XCTAssert(0 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 0);
+
+  [clock tick];
+  XCTAssert(1 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 1);
+  XCTAssertEqualObjects(blockChange[NSKeyValueChangeNewKey], @3.0);
+
+  // no change, no delivery
+  [clock tick];
+  XCTAssert(1 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 1);
+
+  circle.radius = 4.0;
+  [clock tick];
+  XCTAssert(2 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 2);
+  XCTAssertEqualObjects(blockChange[NSKeyValueChangeNewKey], @4.0);
+}
+
+- (void)testFlushWaitsForSampledChange
+{
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  FBKVOTestFrameClock *clock = [FBKVOTestFrameClock clock];
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+
+  __block NSUInteger blockCallCount = 0;
+  [controller observe:circle keyPath:radius options:NSKeyValueObservingOptionNew frameClock:clock block:^(id observer, id object, NSDictionary *change) {
+    blockCallCount++;
+  }];
+
+  // in flight until the next frame
+  circle.radius = 1.0;
+  XCTAssertFalse([controller flushWithTimeout:0.05]);
+
+  [clock tick];
+  XCTAssertTrue([controller flushWithTimeout:1.0]);
+  XCTAssert(1 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 1);
+}
+
+- (void)testPriorityDeliveryTargetsQueueInOrder
+{
+  static void *queueKey = &queueKey;
+  dispatch_queue_t queue = dispatch_queue_create("com.facebook.FBKVOControllerTests.priority", DISPATCH_QUEUE_SERIAL);
+  dispatch_queue_set_specific(queue, queueKey, queueKey, NULL);
+
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+
+  NSMutableArray *values = [NSMutableArray array];
+  __block BOOL onQueue = YES;
+  XCTestExpectation *expectation = [self expectationWithDescription:@"delivery"];
+  [controller observe:circle keyPath:radius options:NSKeyValueObservingOptionNew queue:queue priority:FBKVODeliveryPriorityLow block:^(id observer, id object, NSDictionary *change) {
+    onQueue = onQueue && queueKey == dispatch_get_specific(queueKey);
+    [values addObject:change[NSKeyValueChangeNewKey]];
+    if (3 == values.count) {
+      [expectation fulfill];
+    }
+  }];
+
+  circle.radius = 1.0;
+  circle.radius = 2.0;
+  circle.radius = 3.0;
+  [self waitForExpectationsWithTimeout:1.0 handler:nil];
+
+  NSArray *expectedValues = @[@1.0, @2.0, @3.0];
+  XCTAssertEqualObjects(values, expectedValues);
+  XCTAssertTrue(onQueue);
+}
+
+- (void)testMainQueueDefaultDeliversBurstInOrder
+{
+  [FBKVOController setObserveOnMainQueueByDefault:YES];
+
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+
+  static const NSUInteger changeCount = 1000;
+  NSMutableArray *values = [NSMutableArray array];
+  __block BOOL onMainThread = YES;
+  XCTestExpectation *expectation = [self expectationWithDescription:@"delivery"];
+  [controller observe:circle keyPath:radius options:NSKeyValueObservingOptionNew block:^(id observer, id object, NSDictionary *change) {
+    onMainThread = onMainThread && [NSThread isMainThread];
+    [values addObject:change[NSKeyValueChangeNewKey]];
+    if (changeCount == values.count) {
+      [expectation fulfill];
+    }
+  }];
+  [FBKVOController setObserveOnMainQueueByDefault:NO];
+
+  dispatch_async(dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^{
+    for (NSUInteger idx = 0; idx < changeCount; idx++) {
+      circle.radius = idx;
+    }
+  });
+  [self waitForExpectationsWithTimeout:2.0 handler:nil];
+
+  NSMutableArray *expectedValues = [NSMutableArray array];
+  for (NSUInteger idx = 0; idx < changeCount; idx++) {
+    [expectedValues addObject:@((float)idx)];
+  }
+  XCTAssertEqualObjects(values, expectedValues);
+  XCTAssertTrue(onMainThread);
+}
+
+- (void)testChangeOnTargetQueueDeliversInline
+{
+  dispatch_queue_t queue = dispatch_queue_create("com.facebook.FBKVOControllerTests.inline", DISPATCH_QUEUE_SERIAL);
+
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+
+  __block NSUInteger blockCallCount = 0;
+  [controller observe:circle keyPath:radius options:NSKeyValueObservingOptionNew queue:queue priority:FBKVODeliveryPriorityDefault block:^(id observer, id object, NSDictionary *change) {
+    blockCallCount++;
+  }];
+
+  __block NSUInteger callCountAfterChange = 0;
+  dispatch_sync(queue, ^{
+    circle.radius = 1.0;
+    callCountAfterChange = blockCallCount;
+  });
+  XCTAssert(1 == callCountAfterChange, @"unexpected block call count:%lu expected:%d", (unsigned long)callCountAfterChange, 1);
+}
+
+- (void)testControllerDefaultQueueOverridesGlobalDefault
+{
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *mainController = [FBKVOController controllerWithObserver:observer];
+  mainController.observeOnMainQueueByDefault = YES;
+  FBKVOController *backgroundController = [FBKVOController controllerWithObserver:observer];
+  XCTAssertFalse(backgroundController.observeOnMainQueueByDefault);
+
+  __block BOOL mainOnMainThread = NO;
+  __block BOOL backgroundOnMainThread = YES;
+  XCTestExpectation *expectation = [self expectationWithDescription:@"delivery"];
+  [mainController observe:circle keyPath:radius options:NSKeyValueObservingOptionNew block:^(id observer, id object, NSDictionary *change) {
+    mainOnMainThread = [NSThread isMainThread];
+    [expectation fulfill];
+  }];
+  [backgroundController observe:circle keyPath:radius options:NSKeyValueObservingOptionNew block:^(id observer, id object, NSDictionary *change) {
+    backgroundOnMainThread = [NSThread isMainThread];
+  }];
+
+  dispatch_async(dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^{
+    circle.radius = 1.0;
+  });
+  [self waitForExpectationsWithTimeout:1.0 handler:nil];
+
+  XCTAssertTrue(mainOnMainThread);
+  XCTAssertFalse(backgroundOnMainThread);
+}
+
+- (void)testControllerFollowsGlobalDefaultUntilAssigned
+{
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *followingController = [FBKVOController controllerWithObserver:observer];
+  FBKVOController *assignedController = [FBKVOController controllerWithObserver:observer];
+  assignedController.defaultQueue = NULL;
+
+  [FBKVOController setObserveOnMainQueueByDefault:YES];
+  BOOL followingOnMainQueue = followingController.observeOnMainQueueByDefault;
+  BOOL assignedOnMainQueue = assignedController.observeOnMainQueueByDefault;
+  [FBKVOController setObserveOnMainQueueByDefault:NO];
+
+  XCTAssertTrue(followingOnMainQueue);
+  XCTAssertFalse(assignedOnMainQueue);
+}
+
+- (void)testExecutorReceivesBufferedNotificationsInBatches
+{
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+  FBKVOTestExecutor *executor = [FBKVOTestExecutor executor];
+
+  __block NSUInteger blockCallCount = 0;
+  [controller observe:circle keyPath:radius options:NSKeyValueObservingOptionNew|NSKeyValueObservingOptionPrior executor:executor block:^(id observer, id object, NSDictionary *change) {
+    blockCallCount++;
+  }];
+
+  // prior and change notifications enqueued separately
+  circle.radius = 1.0;
+  XCTAssert(2 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 2);
+
+  // buffered prior and coalesced change notifications enqueued as one batch
+  [FBKVOController beginTransaction];
+  circle.radius = 2.0;
+  circle.radius = 3.0;
+  [FBKVOController commit];
+  XCTAssert(4 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 4);
+
+  NSArray *expectedBatchCounts = @[@1, @1, @2];
+  XCTAssertEqualObjects(executor.batchCounts, expectedBatchCounts);
+}
+
+- (void)testWorkStealingExecutorPreservesOrderPerObservation
+{
+  static const NSUInteger changeCount = 500;
+  FBKVOWorkStealingExecutor *executor = [[FBKVOWorkStealingExecutor alloc] initWithThreadCount:4];
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+
+  NSMutableArray<FBKVOTestCircle *> *circles = [NSMutableArray array];
+  NSMutableArray<NSMutableArray *> *values = [NSMutableArray array];
+  __block BOOL overlapped = NO;
+  for (NSUInteger idx = 0; idx < 4; idx++) {
+    FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+    NSMutableArray *circleValues = [NSMutableArray array];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"delivery"];
+    __block BOOL running = NO;
+    [controller observe:circle keyPath:radius options:NSKeyValueObservingOptionNew executor:executor block:^(id observer, id object, NSDictionary *change) {
+      // values are only touched by one worker at a time
+      overlapped = overlapped || running;
+      running = YES;
+      [circleValues addObject:change[NSKeyValueChangeNewKey]];
+      running = NO;
+      if (changeCount == circleValues.count) {
+        [expectation fulfill];
+      }
+    }];
+    [circles addObject:circle];
+    [values addObject:circleValues];
+  }
+
+  for (NSUInteger idx = 0; idx < changeCount; idx++) {
+    for (FBKVOTestCircle *circle in circles) {
+      circle.radius = idx;
+    }
+  }
+  [self waitForExpectationsWithTimeout:2.0 handler:nil];
+
+  NSMutableArray *expectedValues = [NSMutableArray array];
+  for (NSUInteger idx = 0; idx < changeCount; idx++) {
+    [expectedValues addObject:@((float)idx)];
+  }
+  for (NSMutableArray *circleValues in values) {
+    XCTAssertEqualObjects(circleValues, expectedValues);
+  }
+  XCTAssertFalse(overlapped);
+}
+
+- (void)testSerialControllerNeverOverlapsCallbacks
+{
+  static const NSUInteger changeCount = 200;
+  static const NSUInteger circleCount = 4;
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+  controller.serial = YES;
+  XCTAssertTrue(controller.isSerial);
+
+  // unsynchronized, relying on serialized callbacks
+  __block NSUInteger blockCallCount = 0;
+  __block BOOL running = NO;
+  __block BOOL overlapped = NO;
+  XCTestExpectation *expectation = [self expectationWithDescription:@"delivery"];
+  NSMutableArray<FBKVOTestCircle *> *circles = [NSMutableArray array];
+  for (NSUInteger idx = 0; idx < circleCount; idx++) {
+    FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+    [controller observe:circle keyPath:radius options:NSKeyValueObservingOptionNew block:^(id observer, id object, NSDictionary *change) {
+      overlapped = overlapped || running;
+      running = YES;
+      blockCallCount++;
+      running = NO;
+      if (changeCount * circleCount == blockCallCount) {
+        [expectation fulfill];
+      }
+    }];
+    [circles addObject:circle];
+  }
+
+  for (FBKVOTestCircle *circle in circles) {
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^{
+      for (NSUInteger idx = 1; idx <= changeCount; idx++) {
+        circle.radius = idx;
+      }
+    });
+  }
+  [self waitForExpectationsWithTimeout:2.0 handler:nil];
+
+  XCTAssert(changeCount * circleCount == blockCallCount, @"unexpected block call count:%lu expected:%lu", (unsigned long)blockCallCount, (unsigned long)(changeCount * circleCount));
+  XCTAssertFalse(overlapped);
+}
+
+- (void)testSerialControllerKeepsObservationQueue
+{
+  static void *queueKey = &queueKey;
+  dispatch_queue_t queue = dispatch_queue_create("com.facebook.FBKVOControllerTests.serial", DISPATCH_QUEUE_SERIAL);
+  dispatch_queue_set_specific(queue, queueKey, queueKey, NULL);
+
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+  controller.serial = YES;
+
+  __block BOOL onQueue = NO;
+  XCTestExpectation *expectation = [self expectationWithDescription:@"delivery"];
+  [controller observe:circle keyPath:radius options:NSKeyValueObservingOptionNew queue:queue priority:FBKVODeliveryPriorityDefault block:^(id observer, id object, NSDictionary *change) {
+    onQueue = queueKey == dispatch_get_specific(queueKey);
+    [expectation fulfill];
+  }];
+
+  circle.radius = 1.0;
+  [self waitForExpectationsWithTimeout:1.0 handler:nil];
+  XCTAssertTrue(onQueue);
+}
+
+- (void)testStampedBlockReceivesMonotonicStamps
+{
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  FBKVOTestCircle *otherCircle = [FBKVOTestCircle circle];
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+
+  NSMutableArray<NSValue *> *stamps = [NSMutableArray array];
+  FBKVOStampedNotificationBlock block = ^(id observer, id object, NSDictionary *change, FBKVOChangeStamp stamp) {
+    XCTAssertEqualObjects(change[FBKVONotificationSequenceKey], @(stamp.sequence));
+    [stamps addObject:[NSValue valueWithBytes:&stamp objCType:@encode(FBKVOChangeStamp)]];
+  };
+  [controller observe:circle keyPath:radius options:NSKeyValueObservingOptionNew stampedBlock:block];
+  [controller observe:otherCircle keyPath:radius options:NSKeyValueObservingOptionNew stampedBlock:block];
+
+  uint64_t start = FBKVOTimestampNow();
+  circle.radius = 1.0;
+  otherCircle.radius = 1.0;
+  circle.radius = 2.0;
+  XCTAssert(3 == stamps.count, @"unexpected block call count:%lu expected:%d", (unsigned long)stamps.count, 3);
+
+  FBKVOChangeStamp previous = {0, start};
+  for (NSValue *value in stamps) {
+    FBKVOChangeStamp stamp;
+    [value getValue:&stamp];
+    XCTAssertGreaterThan(stamp.sequence, previous.sequence);
+    XCTAssertGreaterThanOrEqual(stamp.timestamp, previous.timestamp);
+    previous = stamp;
+  }
+  XCTAssertLessThanOrEqual(previous.timestamp, FBKVOTimestampNow());
+}
+
+- (void)testStampedObservationsOfOneChangeShareStamp
+{
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+  FBKVOController *otherController = [FBKVOController controllerWithObserver:observer];
+
+  NSMutableArray<NSNumber *> *sequences = [NSMutableArray array];
+  FBKVOStampedNotificationBlock block = ^(id observer, id object, NSDictionary *change, FBKVOChangeStamp stamp) {
+    [sequences addObject:@(stamp.sequence)];
+  };
+  [controller observe:circle keyPath:radius options:NSKeyValueObservingOptionNew stampedBlock:block];
+  [otherController observe:circle keyPath:radius options:NSKeyValueObservingOptionNew stampedBlock:block];
+
+  circle.radius = 1.0;
+  circle.radius = 2.0;
+  XCTAssert(4 == sequences.count, @"unexpected block call count:%lu expected:%d", (unsigned long)sequences.count, 4);
+  XCTAssertEqualObjects(sequences[0], sequences[1]);
+  XCTAssertEqualObjects(sequences[2], sequences[3]);
+  XCTAssertLessThan(sequences[1].unsignedLongLongValue, sequences[2].unsignedLongLongValue);
+}
+
+- (void)testFlushWaitsForPendingDeliveries
+{
+  dispatch_queue_t queue = dispatch_queue_create("com.facebook.FBKVOControllerTests.flush", DISPATCH_QUEUE_SERIAL);
+
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+
+  __block NSUInteger blockCallCount = 0;
+  [controller observe:circle keyPath:radius options:NSKeyValueObservingOptionNew queue:queue priority:FBKVODeliveryPriorityDefault block:^(id observer, id object, NSDictionary *change) {
+    usleep(10000);
+    blockCallCount++;
+  }];
+
+  circle.radius = 1.0;
+  circle.radius = 2.0;
+  XCTAssertTrue([controller flushWithTimeout:1.0]);
+  XCTAssert(2 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 2);
+
+  circle.radius = 3.0;
+  XCTestExpectation *expectation = [self expectationWithDescription:@"flush"];
+  [controller flushWithCompletion:^{
+    XCTAssert(3 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 3);
+    [expectation fulfill];
+  }];
+  [self waitForExpectationsWithTimeout:1.0 handler:nil];
+}
+
+- (void)testObserveAsyncRegistersOffCallingThread
+{
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+
+  __block NSUInteger blockCallCount = 0;
+  __block BOOL initialOnMainThread = YES;
+  XCTestExpectation *expectation = [self expectationWithDescription:@"registration"];
+  [controller observeAsync:circle keyPath:radius options:NSKeyValueObservingOptionInitial|NSKeyValueObservingOptionNew block:^(id observer, id object, NSDictionary *change) {
+    if (0 == blockCallCount++) {
+      initialOnMainThread = [NSThread isMainThread];
+      [expectation fulfill];
+    }
+  }];
+  [self waitForExpectationsWithTimeout:1.0 handler:nil];
+  XCTAssertFalse(initialOnMainThread);
+
+  // registered, changes notify on the changing thread
+  circle.radius = 1.0;
+  XCTAssert(2 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 2);
+
+  // notifications stop immediately, ahead of Foundation removal
+  [controller unobserveAsync:circle keyPath:radius];
+  circle.radius = 2.0;
+  XCTAssert(2 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 2);
+
+  // observing again is ordered after the pending removal
+  [controller observeAsync:circle keyPath:radius options:NSKeyValueObservingOptionNew block:^(id observer, id object, NSDictionary *change) {
+    blockCallCount++;
+  }];
+  [controller unobserve:circle];
+  circle.radius = 3.0;
+  XCTAssert(2 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 2);
+}
+
+- (void)testObserveCountRemovesObservationAfterLastDelivery
+{
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+
+  __block NSUInteger blockCallCount = 0;
+  [controller observeOnce:circle keyPath:radius options:NSKeyValueObservingOptionInitial block:^(id observer, id object, NSDictionary *change) {
+    blockCallCount++;
+  }];
+  circle.radius = 1.0;
+  XCTAssert(1 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 1);
+
+  // removed, so the key path can be observed again
+  blockCallCount = 0;
+  [controller observe:circle keyPath:radius options:NSKeyValueObservingOptionNew count:2 block:^(id observer, id object, NSDictionary *change) {
+    blockCallCount++;
+  }];
+  circle.radius = 2.0;
+  circle.radius = 3.0;
+  circle.radius = 4.0;
+  XCTAssert(2 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 2);
+}
+
+- (void)testWaitForObjectWakesOnChange
+{
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  BOOL (^predicate)(id) = ^BOOL(NSNumber *value) {
+    return value.floatValue >= 3.0;
+  };
+
+  XCTAssertFalse([FBKVOController waitForObject:circle keyPath:radius predicate:predicate timeout:0.05]);
+
+  dispatch_async(dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^{
+    for (NSUInteger idx = 1; idx <= 3; idx++) {
+      usleep(10000);
+      circle.radius = idx;
+    }
+  });
+  XCTAssertTrue([FBKVOController waitForObject:circle keyPath:radius predicate:predicate timeout:1.0]);
+  XCTAssertEqual(3.0, circle.radius);
+
+  // satisfied without waiting
+  XCTAssertTrue([FBKVOController waitForObject:circle keyPath:radius predicate:predicate timeout:0]);
+}
+
+- (void)testStreamBuffersChangesForConsumer
+{
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+
+  FBKVOStream *stream = [controller streamForObject:circle keyPath:radius capacity:2];
+  XCTAssertEqual(2u, stream.capacity);
+  XCTAssertNil([controller streamForObject:circle keyPath:radius capacity:2]);
+  XCTAssertNil([stream tryNext]);
+
+  // overflow drops the newest change
+  circle.radius = 1.0;
+  circle.radius = 2.0;
+  circle.radius = 3.0;
+  XCTAssertEqual(2u, stream.enqueuedCount);
+  XCTAssertEqual(1u, stream.droppedCount);
+
+  FBKVOChange *change = [stream tryNext];
+  XCTAssertEqual(NSKeyValueChangeSetting, change.kind);
+  XCTAssertEqualObjects(@0.0, change.oldValue);
+  XCTAssertEqualObjects(@1.0, change.newValue);
+
+  NSMutableArray<FBKVOChange *> *changes = [NSMutableArray array];
+  XCTAssertEqual(1u, [stream drainInto:changes]);
+  XCTAssertEqualObjects(@2.0, changes.firstObject.newValue);
+
+  // a waiting consumer wakes on change
+  dispatch_async(dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^{
+    usleep(10000);
+    circle.radius = 4.0;
+  });
+  XCTAssertEqualObjects(@4.0, [stream next].newValue);
+
+  [stream cancel];
+  circle.radius = 5.0;
+  XCTAssertNil([stream next]);
+}
+
+- (void)testObservablePropertyBypassesFoundation
+{
+  id<FBKVOTestObserving> observer = mockProtocol(@protocol(FBKVOTestObserving));
+  FBKVOController *controller = [FBKVOController controllerWithObserver:observer];
+  FBKVOTestObservableCircle *circle = [FBKVOTestObservableCircle circle];
+  circle.radius = 1.0;
+
+  __block NSUInteger blockCallCount = 0;
+  __block NSDictionary *lastChange = nil;
+  [controller observe:circle keyPath:radius options:optionsBasic block:^(id observer, id object, NSDictionary *change) {
+    blockCallCount++;
+    lastChange = change;
+  }];
+
+  // initial notification, without a Foundation registration
+  XCTAssert(1 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 1);
+  XCTAssertEqualObjects(@1.0, lastChange[NSKeyValueChangeNewKey]);
+  XCTAssert(NULL == circle.observationInfo, @"unexpected Foundation registration");
+
+  circle.radius = 2.0;
+  XCTAssert(2 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 2);
+  XCTAssertEqualObjects(@1.0, lastChange[NSKeyValueChangeOldKey]);
+  XCTAssertEqualObjects(@2.0, lastChange[NSKeyValueChangeNewKey]);
+
+  [controller unobserve:circle keyPath:radius];
+  circle.radius = 3.0;
+  XCTAssert(2 == blockCallCount, @"unexpected block call count:%lu expected:%d", (unsigned long)blockCallCount, 2);
+}
+
 - (void)testTravisContinuousIntegrationHappyDance
 {
   // happy dance
@@ -9,6 +9,8 @@
 
 #import <Foundation/Foundation.h>
 
+#import <FBKVOController/FBKVOController.h>
+
 /**
  Circle test object.
  */
@@ -18,6 +20,40 @@
 @property (assign, nonatomic) float borderWidth;
 @end
 
+/**
+ Circle test object, whose radius is an observable property.
+ */
+@interface FBKVOTestObservableCircle : NSObject
++ (instancetype)circle;
+@property (assign, nonatomic) float radius;
+@end
+
+/**
+ Canvas test object, holding a KVO-compliant to-many relationship of circles.
+ */
+@interface FBKVOTestCanvas : NSObject
++ (instancetype)canvas;
+@property (copy, nonatomic) NSArray<FBKVOTestCircle *> *circles;
+- (void)insertObject:(FBKVOTestCircle *)circle inCirclesAtIndex:(NSUInteger)index;
+- (void)removeObjectFromCirclesAtIndex:(NSUInteger)index;
+@end
+
+/**
+ Frame clock test object, ticking only when told to.
+ */
+@interface FBKVOTestFrameClock : NSObject <FBKVOFrameClock>
++ (instancetype)clock;
+- (void)tick;
+@end
+
+/**
+ Executor test object, running deliveries immediately and recording batch sizes.
+ */
+@interface FBKVOTestExecutor : NSObject <FBKVOExecutor>
++ (instancetype)executor;
+@property (copy, nonatomic, readonly) NSArray<NSNumber *> *batchCounts;
+@end
+
 /**
  Observer protocol for mocking.
  */
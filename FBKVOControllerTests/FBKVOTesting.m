@@ -23,6 +23,135 @@
 
 @end
 
+@implementation FBKVOTestObservableCircle
+{
+  FBKVO_OBSERVABLE_STORAGE(radius)
+}
+
+FBKVO_OBSERVABLE_PROPERTY(float, radius, Radius)
+
++ (instancetype)circle
+{
+  return [[self alloc] init];
+}
+
+@end
+
+@implementation FBKVOTestCanvas
+{
+  NSMutableArray<FBKVOTestCircle *> *_circles;
+}
+
++ (instancetype)canvas
+{
+  return [[self alloc] init];
+}
+
+- (instancetype)init
+{
+  self = [super init];
+  if (nil != self) {
+    _circles = [NSMutableArray array];
+  }
+  return self;
+}
+
+- (NSArray<FBKVOTestCircle *> *)circles
+{
+  return [_circles copy];
+}
+
+- (void)setCircles:(NSArray<FBKVOTestCircle *> *)circles
+{
+  _circles = [circles mutableCopy];
+}
+
+- (NSUInteger)countOfCircles
+{
+  return _circles.count;
+}
+
+- (FBKVOTestCircle *)objectInCirclesAtIndex:(NSUInteger)index
+{
+  return _circles[index];
+}
+
+- (void)insertObject:(FBKVOTestCircle *)circle inCirclesAtIndex:(NSUInteger)index
+{
+  [_circles insertObject:circle atIndex:index];
+}
+
+- (void)removeObjectFromCirclesAtIndex:(NSUInteger)index
+{
+  [_circles removeObjectAtIndex:index];
+}
+
+@end
+
+@implementation FBKVOTestFrameClock
+{
+  NSMutableArray<dispatch_block_t> *_blocks;
+}
+
++ (instancetype)clock
+{
+  return [[self alloc] init];
+}
+
+- (instancetype)init
+{
+  self = [super init];
+  if (nil != self) {
+    _blocks = [NSMutableArray array];
+  }
+  return self;
+}
+
+- (void)performOnNextFrame:(dispatch_block_t)block
+{
+  [_blocks addObject:[block copy]];
+}
+
+- (void)tick
+{
+  NSArray<dispatch_block_t> *blocks = _blocks;
+  _blocks = [NSMutableArray array];
+  for (dispatch_block_t block in blocks) {
+    block();
+  }
+}
+
+@end
+
+@implementation FBKVOTestExecutor
+{
+  NSMutableArray<NSNumber *> *_batchCounts;
+}
+
++ (instancetype)executor
+{
+  return [[self alloc] init];
+}
+
+- (instancetype)init
+{
+  self = [super init];
+  if (nil != self) {
+    _batchCounts = [NSMutableArray array];
+  }
+  return self;
+}
+
+- (void)enqueueBlocks:(const dispatch_block_t _Nonnull [_Nonnull])blocks count:(NSUInteger)count observation:(id)observation
+{
+  [_batchCounts addObject:@(count)];
+  for (NSUInteger idx = 0; idx < count; idx++) {
+    blocks[idx]();
+  }
+}
+
+@end
+
 @implementation FBKVOTestObserver
 
 + (instancetype)observer
@@ -0,0 +1,131 @@
+/**
+  Copyright (c) 2014-present, Facebook, Inc.
+  All rights reserved.
+
+  This source code is licensed under the BSD-style license found in the
+  LICENSE file in the root directory of this source tree. An additional grant
+  of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#import <XCTest/XCTest.h>
+
+#import <FBKVOController/FBKVOCoroutine.h>
+#import <FBKVOController/FBKVOTyped.h>
+
+#import "FBKVOTesting.h"
+
+namespace {
+
+struct RadiusObserver {
+  NSUInteger callCount = 0;
+  float oldRadius = 0;
+  float newRadius = 0;
+};
+
+#if defined(__cpp_impl_coroutine)
+
+struct DetachedTask {
+  struct promise_type {
+    DetachedTask get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+DetachedTask record_next_radius(FBKVO::ChangeSequence sequence, NSMutableArray<NSNumber *> *radii)
+{
+  FBKVOChange *change = co_await sequence.next();
+  [radii addObject:change.newValue];
+}
+
+#endif
+
+} // namespace
+
+@interface FBKVOTypedTests : XCTestCase
+@end
+
+@implementation FBKVOTypedTests
+
+- (void)testTypedObservationUnboxesValuesUntilDestroyed
+{
+  RadiusObserver observer;
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  circle.radius = 1.0;
+
+  {
+    FBKVO::Observation observation = FBKVO::observe(observer, circle, FBKVOProperty(FBKVOTestCircle, radius), [](RadiusObserver &o, FBKVOTestCircle *c, float oldValue, float newValue) {
+      o.callCount++;
+      o.oldRadius = oldValue;
+      o.newRadius = newValue;
+    });
+    XCTAssert(observation, @"expected observation");
+
+    circle.radius = 2.0;
+    XCTAssert(1 == observer.callCount, @"unexpected call count:%lu expected:%d", (unsigned long)observer.callCount, 1);
+    XCTAssertEqual(observer.oldRadius, 1.0f);
+    XCTAssertEqual(observer.newRadius, 2.0f);
+
+    // moving transfers the observation
+    FBKVO::Observation moved = std::move(observation);
+    XCTAssertFalse(observation, @"expected moved-from observation to be empty");
+    circle.radius = 3.0;
+    XCTAssert(2 == observer.callCount, @"unexpected call count:%lu expected:%d", (unsigned long)observer.callCount, 2);
+    XCTAssertEqual(observer.newRadius, 3.0f);
+  }
+
+  circle.radius = 4.0;
+  XCTAssert(2 == observer.callCount, @"unexpected call count:%lu expected:%d", (unsigned long)observer.callCount, 2);
+}
+
+- (void)testTypedObservationsShareController
+{
+  RadiusObserver observer;
+  RadiusObserver otherObserver;
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  FBKVOController *controller = [FBKVOController controllerWithObserver:nil];
+
+  // a callable too large for inline storage, moved to the heap
+  double padding[8] = {0};
+  FBKVO::Observation observation = FBKVO::observe(controller, observer, circle, FBKVOProperty(FBKVOTestCircle, radius), [](RadiusObserver &o, FBKVOTestCircle *c, float oldValue, float newValue) {
+    o.callCount++;
+    o.newRadius = newValue;
+  });
+  FBKVO::Observation otherObservation = FBKVO::observe(controller, otherObserver, circle, FBKVOProperty(FBKVOTestCircle, radius), [padding](RadiusObserver &o, FBKVOTestCircle *c, float oldValue, float newValue) {
+    o.callCount++;
+    o.newRadius = newValue + (float)padding[7];
+  });
+
+  // observations of the same key path on one controller are distinct
+  circle.radius = 2.0;
+  XCTAssert(1 == observer.callCount, @"unexpected call count:%lu expected:%d", (unsigned long)observer.callCount, 1);
+  XCTAssert(1 == otherObserver.callCount, @"unexpected call count:%lu expected:%d", (unsigned long)otherObserver.callCount, 1);
+  XCTAssertEqual(otherObserver.newRadius, 2.0f);
+
+  otherObservation.cancel();
+  circle.radius = 3.0;
+  XCTAssert(2 == observer.callCount, @"unexpected call count:%lu expected:%d", (unsigned long)observer.callCount, 2);
+  XCTAssert(1 == otherObserver.callCount, @"unexpected call count:%lu expected:%d", (unsigned long)otherObserver.callCount, 1);
+}
+
+#if defined(__cpp_impl_coroutine)
+
+- (void)testAwaitedChangeResumesOnChange
+{
+  FBKVOTestCircle *circle = [FBKVOTestCircle circle];
+  NSMutableArray<NSNumber *> *radii = [NSMutableArray array];
+
+  record_next_radius(FBKVO::Changes().changes(circle, "radius"), radii);
+  XCTAssert(0 == radii.count, @"unexpected resume count:%lu expected:%d", (unsigned long)radii.count, 0);
+
+  // resumed synchronously by the change, once, ending the sequence from within its delivery
+  circle.radius = 2.0;
+  circle.radius = 3.0;
+  XCTAssertEqualObjects(radii, @[@2.0]);
+}
+
+#endif
+
+@end